@@ -0,0 +1,239 @@
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <DatabaseBenchmark> measures how many URLs the DatabaseWriter logs while
+// reports read the database.
+//
+// Usage: db-benchmark [seconds] [batch size]
+
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdlib>
+
+#include "Poco/Exception.h"
+#include "Poco/File.h"
+#include "Poco/Path.h"
+#include "Poco/Process.h"
+#include "Poco/Runnable.h"
+#include "Poco/Thread.h"
+#include "Poco/Timestamp.h"
+#include "Poco/Util/Application.h"
+
+#include "Database.h"
+#include "DatabaseWriter.h"
+#include "Options.h"
+
+using Poco::File;
+using Poco::Thread;
+using Poco::Timestamp;
+using Poco::Util::Application;
+using namespace Poco::Data::Keywords;
+using namespace std;
+
+/* URLs in the database before the benchmark, for the reports to read */
+#define BENCHMARK_URLS 200000
+/* distinct hostnames among them */
+#define BENCHMARK_HOSTS 5000
+
+
+
+class BenchmarkRows: public HistoryHandler
+	/// Counts the rows of the History, as Report::getHistory() goes through
+	/// them.
+{
+	public:
+		BenchmarkRows() {
+			_rows = 0;
+		}
+
+		void handleRow(const HistoryRow& row) {
+			_rows++;
+		}
+
+	private:
+		int _rows;
+};
+
+
+
+class BenchmarkSniffer: public Poco::Runnable
+	/// Hands URLs to the DatabaseWriter the way the FilterWorkers do, each
+	/// with a path of its own so the UrlCoalescer doesn't merge them.
+{
+	public:
+		BenchmarkSniffer(DatabaseWriter& writer): _writer(writer) {
+			_isStopping = false;
+			_logged = 0;
+		}
+
+		void run() {
+			BlacklistMatch match;
+			while (!_isStopping) {
+				stringstream host, path;
+				host <<"host" <<_logged % BENCHMARK_HOSTS <<".example.com";
+				path <<"/bench/" <<_logged;
+				string h = host.str(), p = path.str();
+				HttpRequestView request;
+				request.host = h;
+				request.target = p;
+				_writer.log(request, Timestamp().epochTime(), false, match);
+				_logged++;
+			}
+		}
+
+		void stop() {
+			_isStopping = true;
+		}
+
+	private:
+		DatabaseWriter &_writer;
+		std::atomic<bool> _isStopping;
+		Poco::UInt64 _logged;
+};
+
+
+
+class DatabaseBenchmark
+	/// Runs the Database and a DatabaseWriter on a file of their own, set up
+	/// like Database(Options&) does, but without the session and bypass
+	/// bookkeeping of a real start.
+{
+	public:
+		DatabaseBenchmark(const string& file, int batchSize) {
+			_file = file;
+			removeFiles();
+			Application::instance().config().setBool("config", true);
+			Options options;
+			SQLite::Connector::registerConnector();
+			_db = new Database();
+			_db->_logger = &Application::instance().logger();
+			_db->_databaseFile = file;
+			_db->_batchSize = (batchSize > 0 ? batchSize : 1);
+			_db->_batchInterval = options.getDbBatchInterval();
+			_db->_sessionRowId = -1;
+			_db->_session = new Session("SQLite", file);
+			_db->setAutoVacuum();
+			_db->setPragmas(*_db->_session, options);
+			_db->createTables();
+			_db->_readSession = new Session("SQLite", file);
+			_db->setPragmas(*_db->_readSession, options);
+			*_db->_readSession <<"PRAGMA query_only = ON", now;
+			_db->setStatements();
+		}
+
+		~DatabaseBenchmark() {
+			delete _db;
+			removeFiles();
+		}
+
+		void fill() {
+			Poco::Int64 time = Timestamp().epochTime();
+			for (int i = 0; i < BENCHMARK_URLS; i++) {
+				stringstream host, path;
+				host <<"host" <<i % BENCHMARK_HOSTS <<".example.com";
+				path <<"/some/page" <<i <<".htm";
+				string h = host.str(), p = path.str();
+				HttpRequestView request;
+				request.host = h;
+				request.target = p;
+				_db->logUrl(request, time - i);
+				if ((i + 1) % 1000 == 0)
+					_db->flushUrls(true);
+			}
+			_db->flushUrls(true);
+		}
+
+		void run(int seconds) {
+			DatabaseWriter writer(_db, 4096, true, 1000, 5, -1);
+			BenchmarkSniffer sniffer(writer);
+			Thread writerThread, snifferThread;
+			Timestamp start;
+			writerThread.start(writer);
+			snifferThread.start(sniffer);
+
+			int reports = 0;
+			while (!start.isElapsed((Timestamp::TimeDiff)seconds * 1000000)) {
+				_db->beginSnapshot();
+				try {
+					report();
+				}
+				catch (...) {
+					_db->endSnapshot();
+					throw;
+				}
+				_db->endSnapshot();
+				reports++;
+			}
+
+			sniffer.stop();
+			snifferThread.join();
+			if (!writer.stop())
+				cerr <<"The writer didn't finish in time" <<endl;
+			writerThread.join();
+			double elapsed = start.elapsed() / 1000000.0;
+
+			cout <<(int)(writer.getWritten() / elapsed) <<" URLs/s written, "
+					<<writer.getDropped() <<" dropped, "
+					<<reports <<" reports, "
+					<<"queue high water " <<writer.getHighWater() <<endl;
+		}
+
+	private:
+		void report()
+			/// Read the database like Report::generate() does.
+		{
+			Warnings warnings = _db->getWarnings();
+			vector<string> hostnames = _db->getDistinctHostnames();
+			BenchmarkRows rows;
+			_db->getHistory(rows, "hostname <> ''", "hostname, path");
+		}
+
+		void removeFiles() {
+			const char *suffix[] = {"", "-wal", "-shm", "-journal"};
+			for (int s = 0; s < 4; s++) {
+				File f(_file + suffix[s]);
+				if (f.exists())
+					f.remove();
+			}
+		}
+
+		string _file;
+		Database *_db;
+};
+
+
+
+int main(int argc, char** argv) {
+	int seconds = (argc > 1 ? atoi(argv[1]) : 10),
+		batchSize = (argc > 2 ? atoi(argv[2]) : 100);
+	Poco::Util::Application app;
+	stringstream file;
+	file <<Poco::Path::temp() <<"db-benchmark-" <<Poco::Process::id()
+			<<".sqlite";
+	try {
+		DatabaseBenchmark benchmark(file.str(), batchSize);
+		benchmark.fill();
+		benchmark.run(seconds);
+	}
+	catch (Poco::Exception &e) {
+		cerr <<e.displayText() <<endl;
+		return 1;
+	}
+	return 0;
+}
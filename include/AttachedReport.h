@@ -0,0 +1,63 @@
+//
+// Library: Net Responsibility
+// Package: Report
+// Module:  AttachedReport
+//
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <AttachedReport> writes the attached report straight to its file
+
+
+
+#ifndef ATTACHEDREPORT_H
+#define ATTACHEDREPORT_H
+
+#include <fstream>
+#include <string>
+
+#include "Poco/Path.h"
+
+/* a bigger attached report is always sent zipped */
+#define ATTACHED_REPORT_ZIP_SIZE (10 * 1024 * 1024)
+
+using Poco::Path;
+using namespace std;
+
+class AttachedReport: public ofstream
+	/// AttachedReport is the file the attached report is written to. Each
+	/// section is written as soon as it's generated, so the report is never
+	/// kept in memory as a whole, however much history there is. When it's
+	/// finished, it's zipped straight from the file if needed.
+{
+	public:
+		AttachedReport();
+
+		void create(const string& dir);
+			/// Remove every file in dir but the reports of today, and open
+			/// the next report of today, named report_<date>_<number>.htm.
+
+		Path finish(bool compress);
+			/// Close the report and return the file to attach. That's a zip
+			/// of the report if compress is true, or if the report is bigger
+			/// than ATTACHED_REPORT_ZIP_SIZE.
+
+	private:
+		string _dir;
+		string _name;
+			/// The name of the report, without extension.
+};
+
+#endif // ATTACHEDREPORT_H
@@ -27,6 +27,8 @@
 
 #include <vector>
 
+#include "KeywordTable.h"
+
 #include "Poco/RegularExpression.h"
 #include "Poco/SharedPtr.h"
 #include "Poco/Timestamp.h"
@@ -54,9 +56,25 @@ struct BlacklistKeyword
 		/// The keyword displayed as a string.
 
 	string category;
+		/// Only set when read back from the database; Filter uses
+		/// categoryId.
+
+	Poco::UInt32 id;
+		/// The KeywordTable ID of asString, set by Filter.
+
+	Poco::UInt32 categoryId;
+		/// The KeywordTable ID of the name of the category, set by Filter.
 
 	vector< SharedPtr<RegularExpression> > re;
 		/// The keyword splitted and compiled as a regular expression.
+
+	vector<string> pattern;
+		/// The source of each regular expression in re.
+
+	vector<string> literal;
+		/// For each regular expression in re, a lower case string that every
+		/// match contains, or an empty string if none was found. Used by
+		/// Filter to skip keywords that can't match.
 };
 
 
@@ -93,8 +111,9 @@ struct BlacklistMatch
 		/// This bool is set to true if it is a whitelist match. In that case it
 		/// will show up in the whitelist section of the report.
 
-	vector<BlacklistKeyword> keyword;	// Change to keywords, more than one.
-		/// The keywords that are found in the URL.
+	KeywordHits keyword;
+		/// The keywords that are found in the URL, as IDs. Resolve them with
+		/// KeywordTable::lookup().
 };
 
 
@@ -121,6 +140,9 @@ struct Extension {
 
 		SharedPtr<RegularExpression> re;
 			/// The regular expression to compare to the extension of the URL.
+
+		string pattern;
+			/// The source of re.
 };
 
 
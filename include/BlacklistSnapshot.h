@@ -0,0 +1,83 @@
+//
+// Library: Net Responsibility
+// Package: Core
+// Module:  BlacklistSnapshot
+//
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <BlacklistSnapshot> saves the parsed blacklist for a faster next start
+
+
+
+#ifndef BLACKLISTSNAPSHOT_H
+#define BLACKLISTSNAPSHOT_H
+
+#include <string>
+
+#include "Poco/Types.h"
+
+#include "Blacklist.h"
+#include "PatternCompiler.h"
+
+/* bump whenever the layout of a snapshot changes */
+#define BLACKLIST_SNAPSHOT_VERSION 1
+#define BLACKLIST_SNAPSHOT_MAGIC "NRBS"
+#define BLACKLIST_SNAPSHOT_SUFFIX ".snapshot"
+
+/* magic, version, XML size and checksum, payload size and checksum */
+#define BLACKLIST_SNAPSHOT_HEADER_LEN 28
+
+using namespace std;
+
+class BlacklistSnapshot
+	/// A snapshot is a binary copy of everything MyXml extracts from a
+	/// blacklist file: the categories, the keywords with their strengths,
+	/// patterns and literals, and the extensions. It's written next to the
+	/// XML file, and memory-mapped on the next start instead of parsing the
+	/// XML again, as long as the XML file is byte for byte the same.
+	///
+	/// The header holds a version, the size and CRC-32 of the XML file and the
+	/// size and CRC-32 of the rest of the snapshot, all little-endian. A
+	/// snapshot that doesn't check out is simply ignored, and a new one is
+	/// written once the XML is parsed.
+	///
+	/// PCRE can't save compiled expressions, so the patterns are still
+	/// compiled when a snapshot is read, with a PatternCompiler.
+{
+	public:
+		static string getPath(const string& xmlPath);
+			/// Returns the path of the snapshot of the blacklist at xmlPath.
+
+		static bool read(const string& xmlPath, Blacklist& blacklist,
+				Extensions& extensions);
+			/// Load the snapshot of the blacklist at xmlPath. Returns false,
+			/// leaving blacklist and extensions untouched, if there's no
+			/// valid snapshot for the XML file as it is now.
+
+		static bool write(const string& xmlPath, const Blacklist& blacklist,
+				const Extensions& extensions);
+			/// Save a snapshot of blacklist and extensions, as parsed from
+			/// the XML file at xmlPath. Returns false if it couldn't be
+			/// written.
+
+	private:
+		static bool checksumFile(const string& path, Poco::UInt64& size,
+				Poco::UInt32& checksum);
+			/// Get the size and CRC-32 of the file at path. Returns false if
+			/// it can't be read.
+};
+
+#endif // BLACKLISTSNAPSHOT_H
@@ -37,7 +37,6 @@
 #include "Poco/Tuple.h"
 #include "Poco/Logger.h"
 #include "Poco/Util/ServerApplication.h"
-#include "Poco/Net/HTTPRequest.h"
 #include "Poco/Thread.h"
 #include "Poco/Process.h"
 
@@ -47,18 +46,39 @@
 #include "Warnings.h"
 #include "Bypasses.h"
 #include "BootHistory.h"
+#include "HttpParser.h"
 
 #include <iostream>
 #include <sstream>
 #include <vector>
 #include <set>
+#include <unordered_map>
+
+/* the schema version, kept in PRAGMA user_version */
+#define DATABASE_VERSION 5
+
+/* the rows fetched at a time from long queries */
+#define DATABASE_BATCH_ROWS 1024
+
+/* the rowids of urls deleted in each transaction when rotating the log */
+#define DATABASE_ROTATE_ROWS 5000
+
+/* the pages given back to the file system at a time by vacuum() */
+#define DATABASE_VACUUM_PAGES 256
+
+/* the partitions of the log a report can read at once, as SQLite attaches
+ * at most 10 databases to a connection by default; the oldest is merged
+ * back into the main database beyond it */
+#define DATABASE_MAX_PARTITIONS 10
+
+/* PRAGMA auto_vacuum of a database that can be vacuumed incrementally */
+#define DATABASE_AUTO_VACUUM_INCREMENTAL 2
 
 using Poco::Timestamp;
 using Poco::Tuple;
 using Poco::Exception;
 using Poco::Data::SQLite::DBLockedException;
 using Poco::Thread;
-using Poco::Net::HTTPRequest;
 using namespace Poco::Data;
 using namespace std;
 
@@ -73,10 +93,18 @@ class Database
 	/// There is no method to write any custom SQLite query. Instead the queries
 	/// are a little more limited. Most methods that returns data from the
 	/// database also takes the arguments where and orderBy. With these you may
-	/// customize the return values.
+	/// customize the return values. The URLs are queried through the view
+	/// history, which has the hostname of each URL as if it was in urls.
 	///
 	/// Queries that are done repeatedly are stored inside Statements. This will
 	/// enchance their speed.
+	///
+	/// With dbPartitions, the URLs, warnings and matches of each reporting
+	/// period are logged to a file of their own, named after the database
+	/// file and the rowid of the report that started the period. They're
+	/// listed in the partitions table. The queries attach them and see them
+	/// through temporary views that shadow the tables, and rotateLog() drops
+	/// a whole file at a time.
 {
 	public:
 		Database();
@@ -99,13 +127,18 @@ class Database
 					/// entries (if found), and the hostnames will be ordered by name.
 
 		Bypasses getBypasses(string where = "", string orderBy
-					= "date, time ASC") const;
+					= "time ASC") const;
 					/// Return all Bypasses found, in a Bypasses object.
 
 		History getHistory(string where = "hostname <> ''", string orderBy
 					= "hostname ASC") const;
 					/// Return all History.
 
+		void getHistory(HistoryHandler& handler, string where
+					= "hostname <> ''", string orderBy = "hostname ASC") const;
+					/// Hand every row of the History to handler, fetching
+					/// DATABASE_BATCH_ROWS of them at a time.
+
 		Warnings getWarnings(string where = "", string orderBy
 					= "u.hostname ASC", bool = false) const;
 					/// Return all Warnings found.
@@ -144,41 +177,200 @@ class Database
 		void logSessionStop();
 			/// Log that the current instance stopped.
 
+		void beginSnapshot();
+			/// Make every query that reads the database, until endSnapshot(),
+			/// see the database as it was when the first of them ran. The
+			/// sniffer may keep writing meanwhile, and isn't held up by it.
+			/// Throws if the partitions of the log can't be attached.
+
+		void endSnapshot();
+
 		void rotateLog(int reportId);
 			/// This method rotated the database, to clean up everything that have
 			/// been included. Only entries older than the time for the report with
 			/// reportId will be deleted. The reportId was given by logReportStart().
+			///
+			/// URLs are deleted DATABASE_ROTATE_ROWS rowids at a time, each
+			/// chunk in its own transaction. How far it got is kept in the
+			/// rotations table, so a rotation that was cut short goes on
+			/// from there when it's run again for the same report, or when
+			/// resumeRotation() is called.
+
+		void resumeRotation();
+			/// Finish a rotation that was cut short, if any. Called when the
+			/// sniffer starts.
+
+		void convertAutoVacuum();
+			/// Make a database from before incremental vacuuming one that can
+			/// be vacuumed incrementally. This takes a full VACUUM, which
+			/// rewrites the whole file, so it's done when the sniffer starts,
+			/// before anything is captured. Does nothing the next time.
+
+		void vacuum();
+			/// Give up to DATABASE_VACUUM_PAGES free pages back to the file
+			/// system. Called by the DatabaseWriter when it's idle in the
+			/// dbVacuumHour. Does nothing to a database that can't be vacuumed
+			/// incrementally, see convertAutoVacuum().
 
 		friend class Sniffer;
+		friend class DatabaseWriter;
+		friend class DatabaseTest;
+		friend class DatabaseBenchmark;
 
 	protected:
+		void setPragmas(Session& session, Options& options);
+			/// Put session in WAL mode and set its synchronous, cache_size and
+			/// mmap_size.
+
+		void createTables();
+			/// Create the tables and indexes, or upgrade them to
+			/// DATABASE_VERSION. Every time is stored as a unix timestamp in
+			/// an INTEGER column named time, and every hostname once in hosts.
+
+		void setAutoVacuum();
+			/// Make a new database one that can be vacuumed incrementally.
+			/// Must be called before setPragmas().
+
+		void rotate(Poco::Int64 datetime);
+			/// Delete the URLs, warnings, matches and bypasses older than
+			/// datetime, as described in rotateLog().
+
+		void startRotation(Poco::Int64 datetime, const vector<string>& schemas,
+				int& start, int& last);
+			/// Set start to the first rowid of urls, in any of schemas, to
+			/// rotate away URLs older than datetime, and last to the last
+			/// one. If a rotation to datetime was cut short, start is where
+			/// it stopped.
+
+		string dropPartitions(Poco::Int64 datetime);
+			/// Delete every partition that only has URLs older than datetime.
+			/// Returns the file of the partition that has URLs on both sides
+			/// of datetime, if any.
+
+		void removePartition(const string& file);
+
+		void mergePartition();
+			/// Move the URLs, warnings and matches of the oldest partition
+			/// back into main, and delete it, if there are
+			/// DATABASE_MAX_PARTITIONS of them. Called before a new one is
+			/// created, so a report can always attach every partition.
+
+		bool isAttached(const string& schema);
+			/// Returns true if schema is attached to the write session.
+
+		void usePartition();
+			/// Attach the partition of the latest report to the write
+			/// session as current, creating it if needed. Called before
+			/// URLs are written, so it does nothing unless logReportStart()
+			/// has logged a new report since.
+
+		void attachPartitions() const;
+			/// Attach the partitions to the read session, and create the
+			/// views history, warnings and matches over all of them, if
+			/// they have changed. Nothing is done within a snapshot. Throws
+			/// if there are more than DATABASE_MAX_PARTITIONS of them.
+
+		void detachPartitions() const;
+
+		bool migrateTable(const string& table, const string& columns,
+				const string& kept);
+			/// Replace an old table, with separate local date and time
+			/// columns, by one with columns, copying the kept columns and the
+			/// rowids. Returns false if there was no such table.
+
+		bool migrateHosts();
+			/// Move the hostnames of the urls table into the hosts table,
+			/// keeping the rowids of urls. Returns false if there were no urls.
+
+		bool migrateHits();
+			/// Add the hits and lastSeen columns to urls. Returns false if
+			/// there was no urls table.
+
+		int getHostId(const string& hostname);
+			/// Return the rowid of hostname in hosts, adding it if it's new.
+			/// The IDs are kept in _hostIds, so the database is only asked
+			/// for the first URL of each host.
+
 		void setStatements();
 
-		void logUrl(HTTPRequest& request);
-			/// Log a URL that's visited. This may only be done by the Sniffer class.
+		void logUrl(const HttpRequestView& request, Poco::Int64 time,
+				int hits = 1, Poco::Int64 lastSeen = 0);
+			/// Log a URL that's visited at time, and hits - 1 more times until
+			/// lastSeen. This may only be done by the DatabaseWriter. The URL
+			/// is only queued; it's written by flushUrls().
 			// This will later be replaced by HTTPHit.
 
-		void logWarning(BlacklistMatch match);
+		void logWarning(const BlacklistMatch& match);
 			/// Log a Warning that is flagged by the Filter. It is connected to
-			/// the last URL inserted.
+			/// the last URL logged.
 
-		void logMatch(BlacklistMatch match);
+		void flushUrls(bool force = false);
+			/// Write the queued URLs, warnings and matches in one transaction,
+			/// if there are dbBatchSize of them or the oldest has waited for
+			/// dbBatchInterval milliseconds. With force they're always written.
+			/// If the database stays locked, they're kept for the next flush.
+			/// If the transaction fails otherwise, see replayUrls().
+
+		bool replayUrls();
+			/// Write the queued URLs one transaction each, so only those that
+			/// fail by themselves are dropped, with a warning. Returns false
+			/// if the database got locked; the URLs not yet written are kept.
+
+		void logMatch(const BlacklistMatch& match);
+
+		void rollback();
+			/// Roll back the current transaction, if any.
 
 		void logBypassShutdown(int datetime, int gap = 0);
 
-		void getMatches(vector<int> urlId, vector<BlacklistMatch>& bm) const;
+		void getMatches(const string& where, const vector<int>& urlId,
+				vector<BlacklistMatch>& bm) const;
+			/// Put the matches of every warning selected by where in bm, in
+			/// the same order as urlId, with one query.
 
 		void processPreviousSessions();
 			/// Process the previous sessions, and log any attempts to bypass NR.
 
 	private:
+		struct PendingUrl
+			/// A URL, and possibly its warning, waiting to be written.
+		{
+			string hostname;
+			string path;
+			Poco::Int64 time;
+			int hits;
+			Poco::Int64 lastSeen;
+			bool isWarning;
+			BlacklistMatch match;
+		};
+
+		void writeUrl(const PendingUrl& url);
+			/// Write one queued URL, and its warning and matches, in the
+			/// current transaction.
+
 		Session *_session;
+		Session *_readSession;
+			/// A read-only connection for every query that only reads, so
+			/// reports can keep a snapshot open while URLs are written.
+		bool _isPartitioned;
+		string _databaseFile;
+		int _partitionReportId;
+			/// The report whose partition is attached as current, or -1.
+		int _lastReportId;
+			/// The latest report, read once by usePartition() and then kept
+			/// up to date by logReportStart(), or -1. A report logged by
+			/// another process is picked up when the sniffer starts again.
+		string _partitionFile;
+		mutable vector<string> _readPartitions;
+			/// The partitions attached to the read session, as p0, p1...
 		Timestamp _timestamp;
 		int _lastRowId;
 		int _sessionRowId;
 		int _strength;
-		int _date;
-		int _time;
+		Poco::Int64 _time;
+		int _hits;
+		Poco::Int64 _lastSeen;
+		int _hostId;
 		string _hostname;
 		string _path;
 		string _keyword;
@@ -190,6 +382,15 @@ class Database
 		Statement *_logUrlStatement;
 		Statement *_logWarningStatement;
 		Statement *_logMatchStatement;
+		Statement *_logHostStatement;
+		Statement *_getHostIdStatement;
+		unordered_map<string, int> _hostIds;
+			/// The ID of every host logged by this process.
+		vector<PendingUrl> _pending;
+		size_t _pendingCount;
+		Timestamp _pendingSince;
+		int _batchSize;
+		int _batchInterval;
 };
 
 #endif // DATABASE_H
@@ -0,0 +1,159 @@
+//
+// Library: Net Responsibility
+// Package: Core
+// Module:  DatabaseWriter
+//
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <DatabaseWriter> is the only thread writing visited URLs to the database
+
+
+
+#ifndef DATABASEWRITER_H
+#define DATABASEWRITER_H
+
+#include <iostream>
+#include <vector>
+#include <sstream>
+#include <exception>
+
+#include "Poco/Runnable.h"
+#include "Poco/Mutex.h"
+#include "Poco/Condition.h"
+#include "Poco/Event.h"
+#include "Poco/Timestamp.h"
+#include "Poco/Logger.h"
+#include "Poco/Exception.h"
+
+#include "Blacklist.h"
+#include "HttpParser.h"
+#include "UrlCoalescer.h"
+
+using Poco::Logger;
+using Poco::Timestamp;
+using namespace std;
+
+class Database;
+
+/* how long stop() waits for the queue to be written, in milliseconds */
+#define DATABASE_WRITER_STOP_TIMEOUT 30000
+
+struct LogEvent
+	/// A visited URL, and its warning if it matched, waiting to be written.
+{
+	string hostname;
+	string path;
+	Poco::Int64 time;
+		/// The capture time, as a unix timestamp.
+
+	bool isMatch;
+	BlacklistMatch match;
+};
+
+class DatabaseWriter: public Poco::Runnable
+	/// DatabaseWriter owns every write of visited URLs to the Database. The
+	/// FilterWorkers hand their results over through a bounded queue, and the
+	/// writer thread is the only one calling Database::logUrl(),
+	/// Database::logWarning() and Database::flushUrls(). A locked database
+	/// therefore only stalls this thread.
+	///
+	/// When the queue is full, log() either drops the event and counts it, or
+	/// blocks the calling FilterWorker until there's room, depending on
+	/// dbQueuePolicy. Either way packet capture goes on, since the
+	/// SnifferThreads never wait for the FilterWorkers.
+	///
+	/// Visits of a URL that didn't match are counted by a UrlCoalescer for
+	/// dbCoalesceWindow seconds, and logged as one row with the number of
+	/// hits. When the queue is idle in the dbVacuumHour, the free pages of
+	/// the database are given back a few at a time.
+	///
+	/// stop() lets the writer thread write what's left and log the session
+	/// stop, so no other thread touches the Database's session on shutdown.
+{
+	public:
+		DatabaseWriter(Database* db, int capacity, bool isBlocking,
+				int flushInterval, int coalesceWindow, int vacuumHour);
+			/// Create a writer for db, with room for capacity events. Queued
+			/// batches are flushed at least every flushInterval milliseconds,
+			/// and repeated URLs are collapsed within coalesceWindow seconds.
+			/// The database is vacuumed in vacuumHour, unless it's -1.
+
+		void log(const HttpRequestView& request, Poco::Int64 time,
+				bool isMatch, const BlacklistMatch& match);
+			/// Queue a URL, and its warning if isMatch. May be called by any
+			/// thread. Returns without queueing if the queue is full and the
+			/// policy is to drop.
+
+		virtual void run();
+			/// Write queued events until stop() is called. Exceptions are
+			/// logged and don't stop the writer.
+
+		bool stop();
+			/// Stop the writer thread, once it has written the queued events
+			/// and every URL held by the UrlCoalescer, and logged the session
+			/// stop. Waits up to DATABASE_WRITER_STOP_TIMEOUT milliseconds for
+			/// it, and returns false if that wasn't enough; the thread is
+			/// still writing then. Events logged meanwhile are dropped.
+
+		size_t getDepth() const;
+			/// Returns the number of events in the queue.
+
+		size_t getHighWater() const;
+			/// Returns the highest number of events seen in the queue.
+
+		Poco::UInt64 getDropped() const;
+			/// Returns the number of events dropped because the queue was full.
+
+		Poco::UInt64 getWritten() const;
+			/// Returns the number of events taken off the queue.
+
+	private:
+		Database *_db;
+		Logger *_logger;
+		vector<LogEvent> _queue;
+		size_t _head;
+		size_t _count;
+		size_t _highWater;
+		bool _isBlocking;
+		int _flushInterval;
+		int _vacuumHour;
+		Poco::UInt64 _dropped;
+		Poco::UInt64 _written;
+		LogEvent _event;
+		UrlCoalescer _coalescer;
+		CoalescedUrl _url;
+		Timestamp _lastStats;
+		mutable Poco::FastMutex _mutex;
+		Poco::Condition _notEmpty;
+		Poco::Condition _notFull;
+		bool _isStopping;
+		Poco::Event _stopped;
+			/// Set by the writer thread when it's done, after stop(). Not
+			/// reset by a wait, so stop() may be called more than once.
+
+		bool pop(long timeout);
+		void write(HttpRequestView& request);
+			/// Log the event taken off the queue, unless it's held by the
+			/// UrlCoalescer.
+		void release(HttpRequestView& request, Poco::Int64 now, bool all);
+			/// Log the URLs let go by the UrlCoalescer at now.
+		bool isStopping() const;
+		void logError(const string& message);
+			/// Log what was thrown while writing. The writer goes on.
+		void logStats();
+};
+
+#endif // DATABASEWRITER_H
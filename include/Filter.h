@@ -24,27 +24,67 @@
 #define FILTER_H
 
 #include "Blacklist.h"
+#include "BlacklistSnapshot.h"
 #include "MyXml.h"
 
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <atomic>
 
 #include "Poco/RegularExpression.h"
 #include "Poco/SharedPtr.h"
 #include "Poco/Exception.h"
 #include "Poco/URI.h"
-#include "Poco/Net/HTTPRequest.h"
 #include "Poco/Util/Application.h"
 
+#include "HttpParser.h"
+#include "LiteralMatcher.h"
+#include "LruCache.h"
+#include "MultiMatcher.h"
+
 using Poco::RegularExpression;
 using Poco::SharedPtr;
-using Poco::Net::HTTPRequest;
 using Poco::Util::Application;
 using namespace std;
 
+/* a host is only skipped after this many URLs without a keyword hit, and
+ * even then every HOST_CACHE_RECHECK:th of its URLs is filtered anyway */
+#define HOST_CACHE_MIN_CLEAN 32
+#define HOST_CACHE_RECHECK 16
+
+/* the longest URL extension looked for, small enough to pack in a UInt32 */
+#define EXTENSION_MAX_LEN 4
+
 class Options;
 class Database;
+
+struct FilterVerdict
+	/// The outcome of Filter::isMatch() for a URL.
+{
+	bool isMatch;
+
+	BlacklistMatch match;
+		/// Only set if isMatch is true.
+};
+
+
+
+struct HostHistory
+	/// What Filter has seen of a hostname so far.
+{
+	Poco::UInt32 clean;
+		/// The number of URLs filtered without any keyword hit.
+
+	Poco::UInt32 skipped;
+		/// The number of URLs not filtered since the host was clean enough.
+
+	bool hasHit;
+		/// True once any URL of the host has had a keyword hit.
+};
+
+
+
 
 class Filter
 	/// This class will run all test to find out if the URLs are appropriate or
@@ -54,8 +94,12 @@ class Filter
 	/// match will be given an individual strength to indicate how likely it is
 	/// to be an inappropriate site. (The higher number, the more likely).
 	///
-	/// The URLs are filtered instantly, rather than at report time, as done in
+	/// The URLs are filtered instantly, rather than at report time, as done in
 	/// several previous versions.
+	///
+	/// Once loaded, a Filter isn't changed, except for its caches and
+	/// counters, which are thread-safe. A new blacklist means a new Filter,
+	/// see FilterLoader.
 {
 	public:
 		Filter();
@@ -65,31 +109,131 @@ class Filter
 
 		Filter(Options* options, Database* db);
 			/// Load the Filter, given both the options and database.
+
+		Filter(Options* options);
+			/// Load the Filter to replace a running one. Unlike the
+			/// constructor above, nothing is downloaded or logged to the
+			/// database if the blacklist can't be loaded; the exception is
+			/// thrown instead.
 
-		bool isMatch(HTTPRequest& request, BlacklistMatch& blacklistMatch);
+		bool isMatch(const HttpRequestView& request,
+				BlacklistMatch& blacklistMatch);
 			/// This is the method used for running a complete scan on the URL.
-			/// The URL is given as a HTTPRequest, and the result with a formatted
+			/// The URL is given as a HttpRequestView, and the result with a formatted
 			/// URL, strength etc. is returned in blacklistMatch. The return value
 			/// is true if the URL is considered suspicious, otherwise false.
 
-		bool isUrlMatch(HTTPRequest& request, BlacklistMatch& blacklistMatch);
+		bool isUrlMatch(const HttpRequestView& request,
+				BlacklistMatch& blacklistMatch);
 
-		bool isTokenMatch(HTTPRequest& request, BlacklistMatch& blacklistMatch);
+		bool isTokenMatch(const HttpRequestView& request,
+				BlacklistMatch& blacklistMatch);
 
 		void loadBlacklist(string path);
 
 		void loadBlacklist(Options* options, Database* db);
 
+		Poco::UInt64 getUrlsScanned() const;
+			/// Returns the number of URLs run through isUrlMatch().
+
+		Poco::UInt64 getKeywordsConfirmed() const;
+			/// Returns the number of keywords whose regular expressions were
+			/// run, since all their literals occurred in the URL.
+
+		Poco::UInt64 getKeywordsSkipped() const;
+			/// Returns the number of keywords skipped, since at least one of
+			/// their literals didn't occur in the URL.
+
+		const LruCache<FilterVerdict>& getVerdictCache() const;
+			/// Returns the cache of URL verdicts, for its counters.
+
+		const LruCache<HostHistory>& getHostCache() const;
+			/// Returns the cache of host histories, for its counters.
+
 	private:
 		Blacklist _blacklist;
 		Extensions _extensions;
-		SharedPtr<RegularExpression> _splitToken;
-		SharedPtr<RegularExpression> _splitExtension;
-		SharedPtr<RegularExpression> _wordDelimiter;
+		vector<Poco::UInt32> _extensionKeys;
+		vector<int> _extensionIds;
+			/// An open addressing table from the packed text of every literal
+			/// extension pattern to its index in _extensions.
+		vector<int> _extensionPatterns;
+			/// The indices in _extensions of the patterns that aren't literal.
+		LiteralMatcher _literals;
+		vector< vector<int> > _keywordLiterals;
+			/// The ids in _literals of each keyword, in blacklist order.
+		MultiMatcher _multiMatcher;
+		vector< vector<int> > _keywordPatterns;
+			/// The id in _multiMatcher of each regular expression of each
+			/// keyword, in blacklist order, or -1 if it's run by PCRE.
+		vector<const BlacklistKeyword*> _keywords;
+			/// Every keyword of _blacklist, in blacklist order, as
+			/// KeywordHit::index refers to them.
+		Poco::UInt32 _whitelistId;
+			/// The KeywordTable ID of the "Whitelist" category.
+		bool _isCombined;
+			/// True if filterEngine is "dfa".
+		LruCache<FilterVerdict> _verdicts;
+			/// The verdicts of recently filtered URLs, keyed by host and URI.
+		LruCache<HostHistory> _hosts;
+		std::atomic<Poco::UInt64> _urlsScanned;
+		std::atomic<Poco::UInt64> _keywordsConfirmed;
+		std::atomic<Poco::UInt64> _keywordsSkipped;
 
-		string abbrUrl(string boldUrl);
-		void setRegexps();
-		float getExtensionFactor(string url);
+		static bool isCandidate(const vector<int>& literals,
+				const vector<char>& found);
+			/// Returns true if every literal of a keyword was found.
+
+		static bool nextToken(string_view text, size_t& offset,
+				string_view& token);
+			/// Put the token of text starting at offset in token, and move
+			/// offset past the delimiter after it. Tokens are delimited by
+			/// "/", "#", "%2F", and by "?", "&" or ";" up to the next "=" on
+			/// the same line. Returns false if offset is at the end of text.
+
+		static bool isWordDelimiter(char c);
+			/// Returns true if c ends a word: whitespace, '-', '_', '+', '"',
+			/// '\'' or '.'.
+
+		static void highlight(const RegularExpression& re, string& text);
+			/// Put every match of re in text between <b> and </b>, just as
+			/// subst(text, "<b>$0</b>", RE_GLOBAL) does, but in place.
+
+		static void abbreviate(const string& boldUrl, string& abbrUrl);
+			/// Write boldUrl to abbrUrl, cutting the long stretches of plain
+			/// text around the bold words to " ... ".
+
+		void setOptions(Options* options);
+		void readBlacklist(Options* options);
+			/// Load the blacklist from its snapshot or XML file, or throw.
+		bool isHostClean(const HttpRequestView& request);
+			/// Returns true if request may skip filtering, since its host
+			/// has been filtered often enough without any keyword hit.
+		void updateHost(const HttpRequestView& request, bool hasHit);
+		void buildLiteralMatcher();
+			/// Build _literals from the literals of every keyword.
+		void buildMultiMatcher();
+			/// Build _multiMatcher from every regular expression it can run,
+			/// if _isCombined.
+		void buildKeywordTable();
+			/// Give every keyword its KeywordTable IDs and build _keywords.
+		void buildExtensionTable();
+			/// Build _extensionKeys, _extensionIds and _extensionPatterns from
+			/// _extensions.
+
+		static bool findExtension(const string& url, size_t& start,
+				size_t& length);
+			/// Find the extension of the file in url, just as the regular
+			/// expression "/?(?:[^/?#]+/)+(?:[^?#]+\.)([a-zA-Z0-9]{1,4})(?:$|\?|#).*"
+			/// did. Returns false if there's none.
+
+		static Poco::UInt32 packExtension(const char* text, size_t length);
+			/// Returns up to EXTENSION_MAX_LEN characters, in lower case, as
+			/// a key for _extensionKeys.
+
+		float getExtensionFactor(const string& url);
+
+		friend class FilterTest;
 
 };
 
@@ -0,0 +1,89 @@
+//
+// Library: Net Responsibility
+// Package: Core
+// Module:  FilterLoader
+//
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <FilterLoader> builds a new Filter whenever the blacklist changes
+
+
+
+#ifndef FILTERLOADER_H
+#define FILTERLOADER_H
+
+#include <atomic>
+
+#include "Poco/Runnable.h"
+#include "Poco/Timestamp.h"
+#include "Poco/File.h"
+#include "Poco/Logger.h"
+
+using Poco::Logger;
+using Poco::Timestamp;
+using namespace std;
+
+class Options;
+
+class FilterLoader: public Poco::Runnable
+	/// FilterLoader runs in the background and loads the blacklist again
+	/// whenever the blacklist file has changed, or when requestReload() is
+	/// called. Each time, a complete new Filter is built and handed to
+	/// Sniffer::publishFilter(); the FilterWorkers switch to it before their
+	/// next URL, while the packet capture goes on.
+	///
+	/// If the new blacklist can't be loaded, the current Filter is kept.
+{
+	public:
+		FilterLoader(Options* options, int checkInterval);
+			/// Create a loader checking the blacklist file every checkInterval
+			/// seconds, or only on request if checkInterval is 0.
+
+		virtual void run();
+			/// Wait for changes and reload until stop() is called.
+
+		void stop();
+			/// Make run() return within a second. A reload in progress is
+			/// finished first.
+
+		static void requestReload();
+			/// Make the running loader reload the blacklist within a second.
+			/// Only sets a flag, so it's safe to call from a signal handler.
+
+	private:
+		Options *_options;
+		Logger *_logger;
+		Timestamp::TimeDiff _checkInterval;
+		Timestamp _lastCheck;
+		Timestamp _modified;
+		Poco::File::FileSize _size;
+		bool _isChanging;
+			/// True if the file has changed since the last check, but might
+			/// still be being written.
+		std::atomic<bool> _isStopping;
+		static std::atomic<bool> _isReloadRequested;
+
+		bool hasChanged();
+			/// Returns true once the blacklist file has changed, and then
+			/// stayed the same for a whole check.
+
+		void remember();
+			/// Remember the size and modification time of the blacklist file.
+
+		void reload();
+};
+
+#endif // FILTERLOADER_H
@@ -0,0 +1,164 @@
+//
+// Library: Net Responsibility
+// Package: Core
+// Module:  FilterWorker
+//
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <FilterWorker> drains captured requests, filters them and logs them
+
+
+
+#ifndef FILTERWORKER_H
+#define FILTERWORKER_H
+
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <cstring>
+
+#include "Poco/Runnable.h"
+#include "Poco/Thread.h"
+#include "Poco/Timestamp.h"
+#include "Poco/LogStream.h"
+#include "Poco/Util/Application.h"
+#include "Poco/SharedPtr.h"
+
+#include "Blacklist.h"
+#include "SpscRing.h"
+#include "HttpParser.h"
+#include "LruCache.h"
+
+/* longest hostname and request-target kept in a UrlRecord itself */
+#define RECORD_HOST_LEN 256
+#define RECORD_URI_LEN 2048
+
+using Poco::LogStream;
+using Poco::Timestamp;
+using Poco::Util::Application;
+using namespace std;
+
+class Filter;
+
+struct UrlRecord
+	/// The fixed-size record a SnifferThread hands over to the FilterWorkers.
+	/// It holds only what was extracted from the packet; everything else is
+	/// done by the worker. Longer hostnames are truncated, as no such host
+	/// exists. A longer URI is allocated on its own instead, since cutting it
+	/// short could hide the part that matches the blacklist.
+{
+	Poco::Int64 time;
+		/// The capture time, as a unix timestamp.
+
+	unsigned short hostLength;
+	unsigned short uriLength;
+	char host[RECORD_HOST_LEN];
+	char uri[RECORD_URI_LEN];
+	string *longUri;
+		/// The URI if it's longer than RECORD_URI_LEN, or NULL. Deleted by
+		/// the FilterWorker, or by the SnifferThread if the ring is full.
+
+	void set(string_view hostname, string_view path, Poco::Int64 t)
+	{
+		time = t;
+		hostLength = (unsigned short)(hostname.length() < RECORD_HOST_LEN
+				? hostname.length() : RECORD_HOST_LEN);
+		memcpy(host, hostname.data(), hostLength);
+		if (path.length() <= RECORD_URI_LEN) {
+			uriLength = (unsigned short)path.length();
+			memcpy(uri, path.data(), uriLength);
+			longUri = NULL;
+		}
+		else {
+			uriLength = 0;
+			longUri = new string(path.data(), path.length());
+		}
+	}
+
+	string_view getUri() const
+	{
+		return (longUri != NULL ? string_view(*longUri)
+				: string_view(uri, uriLength));
+	}
+};
+
+typedef SpscRing<UrlRecord> UrlRing;
+
+class FilterWorker: public Poco::Runnable
+	/// A FilterWorker drains one UrlRing from every SnifferThread, runs the
+	/// Filter on each request and hands the result to the Database. Capture
+	/// threads therefore never wait for a slow regular expression or a locked
+	/// database; if the workers fall behind, the rings fill up and their
+	/// overflow counters tell how many requests were lost.
+{
+	public:
+		FilterWorker(int id);
+
+		void addRing(UrlRing* ring);
+			/// Add a ring to drain. Must be called before the worker is started.
+
+		virtual void run();
+			/// Drain the rings until stop() is called.
+
+		void stop();
+			/// Make run() return, once the rings are empty. The SnifferThreads
+			/// should be stopped first, or records are left in the rings.
+
+		size_t getOccupancy() const;
+			/// Returns the number of records waiting in this worker's rings.
+
+		size_t getOverflows() const;
+			/// Returns the number of records dropped in this worker's rings.
+
+		Poco::UInt64 getProcessed() const;
+			/// Returns the number of records filtered by this worker.
+
+	private:
+		int _id;
+		vector<UrlRing*> _rings;
+		Poco::SharedPtr<Filter> _filter;
+		Poco::UInt32 _filterGeneration;
+			/// The generation of _filter, see Sniffer::getFilterGeneration().
+		LogStream *_logStream;
+		bool _isDebugging;
+		HttpRequestView _request;
+		BlacklistMatch _match;
+		std::atomic<Poco::UInt64> _processed;
+		std::atomic<bool> _isStopping;
+		Timestamp _lastStats;
+
+		bool drain();
+			/// Process every record in the rings. Returns false if there
+			/// were none.
+
+		void process(const UrlRecord& record);
+		void logStats();
+
+		template <class T>
+		void logCacheStats(const string& name, const LruCache<T>& cache)
+		{
+			Poco::UInt64 hits = cache.getHits(),
+				lookups = hits + cache.getMisses();
+			if (cache.capacity() == 0 || lookups == 0)
+				return;
+			*_logStream <<name <<": " <<cache.size() <<"/" <<cache.capacity()
+					<<", " <<100.0 * hits / lookups <<"% of " <<lookups
+					<<" lookups hit, " <<cache.getEvictions() <<" evictions" <<endl;
+		}
+};
+
+#include "Sniffer.h"
+#endif // FILTERWORKER_H
@@ -45,7 +45,8 @@ using namespace std;
 struct HistoryRow
 	/// A struct that contains each row of the urls table. It is actually nothing
 	/// more than the URL split up in hostname and path, as well as the time,
-	/// divided in time, date and datetime.
+	/// divided in time, date and datetime. Repeated visits within a short
+	/// while are one row, with the number of hits and the last visit.
 {
 	public:
 		string hostname;
@@ -53,6 +54,21 @@ struct HistoryRow
 		Timestamp date;
 		Timestamp time;
 		Timestamp dateTime;
+		int hits;
+		Timestamp lastSeen;
+};
+
+
+class HistoryHandler
+	/// Implement HistoryHandler to go through the rows of
+	/// Database::getHistory() one at a time, instead of getting them all at
+	/// once in a History.
+{
+	public:
+		virtual ~HistoryHandler();
+
+		virtual void handleRow(const HistoryRow& row) = 0;
+			/// Called for each row, in order.
 };
 
 
@@ -138,6 +154,17 @@ class History
 		Timestamp getDateTime(int index) const;
 			/// Get the date and time of index as a Timestamp.
 
+		int getHits() const;
+			/// Returns the number of times the current URL was visited in a
+			/// row, from getDateTime() until getLastSeen().
+
+		int getHits(int index) const;
+
+		Timestamp getLastSeen() const;
+			/// Get the date and time of the last visit of the current URL.
+
+		Timestamp getLastSeen(int index) const;
+
 		bool hasMore() const;
 			/// Returns true if there are any more rows to iterate through. Very
 			/// useful to put inside a while condition e.g.
@@ -164,7 +191,7 @@ class TypeHandler<class HistoryRow>
 public:
 	static size_t size()
 	{
-		return 4; // we handle four columns of the Table!
+		return 6; // we handle six columns of the Table!
 	}
 
 	static void bind(size_t pos, const HistoryRow& obj, AbstractBinder* pBinder, AbstractBinder::Direction dir)
@@ -174,6 +201,8 @@ public:
 		TypeHandler<string>::bind(pos++, obj.path, pBinder, dir);
 		TypeHandler<Int64>::bind(pos++, obj.date.epochTime(), pBinder, dir);
 		TypeHandler<Int64>::bind(pos++, obj.time.epochTime(), pBinder, dir);
+		TypeHandler<int>::bind(pos++, obj.hits, pBinder, dir);
+		TypeHandler<Int64>::bind(pos++, obj.lastSeen.epochTime(), pBinder, dir);
 	}
 
 	static void prepare(size_t pos, const HistoryRow& obj,
@@ -185,6 +214,8 @@ public:
 		TypeHandler<string>::prepare(pos++, obj.path, pPrepare);
 		TypeHandler<Int64>::prepare(pos++, obj.date.epochTime(), pPrepare);
 		TypeHandler<Int64>::prepare(pos++, obj.time.epochTime(), pPrepare);
+		TypeHandler<int>::prepare(pos++, obj.hits, pPrepare);
+		TypeHandler<Int64>::prepare(pos++, obj.lastSeen.epochTime(), pPrepare);
 	}
 
 	static void extract(size_t pos, HistoryRow& obj,
@@ -192,15 +223,18 @@ public:
 		/// obj will contain the result, defVal contains values we should use when one column is NULL
 	{
 		poco_assert_dbg (pExt != 0);
-		Int64 d, t, dt;
+		Int64 d, t, dt, l;
 		TypeHandler<string>::extract(pos++, obj.hostname, defVal.hostname, pExt);
 		TypeHandler<string>::extract(pos++, obj.path, defVal.path, pExt);
 		TypeHandler<Int64>::extract(pos++, d, defVal.date.epochTime(), pExt);
 		TypeHandler<Int64>::extract(pos++, t, defVal.time.epochTime(), pExt);
+		TypeHandler<int>::extract(pos++, obj.hits, 1, pExt);
+		TypeHandler<Int64>::extract(pos++, l, t, pExt);
 		dt = d + (t % 86400);
 		obj.date = Timestamp::fromEpochTime(d);
 		obj.time = Timestamp::fromEpochTime(t);
 		obj.dateTime = Timestamp::fromEpochTime(dt);
+		obj.lastSeen = Timestamp::fromEpochTime(l);
 	}
 };
 
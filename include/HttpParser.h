@@ -0,0 +1,95 @@
+//
+// Library: Net Responsibility
+// Package: Core
+// Module:  HttpParser
+//
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <HttpParser> extracts the request line and Host header of an HTTP request
+
+
+
+#ifndef HTTPPARSER_H
+#define HTTPPARSER_H
+
+#include <string>
+#include <string_view>
+#include <cstring>
+
+using std::string;
+using std::string_view;
+
+struct HttpRequestView
+	/// HttpRequestView holds the parts of an HTTP request that Net
+	/// Responsibility cares about. The views point straight into the buffer
+	/// that was parsed, so it is only valid as long as that buffer is.
+{
+	string_view method;
+		/// The request method, e.g. "GET".
+
+	string_view target;
+		/// The request-target as sent by the client, e.g. "/index.html?a=b".
+
+	string_view host;
+		/// The value of the Host header, including any port.
+
+	bool empty() const
+		/// Returns true if no request was found.
+	{
+		return target.empty();
+	}
+
+	void clear()
+	{
+		method = target = host = string_view();
+	}
+
+	void getUrl(string& url) const
+		/// Assign the hostname followed by the request-target to url. The
+		/// capacity of url is reused, so keep it around between calls.
+	{
+		url.assign(host.data(), host.length());
+		url.append(target.data(), target.length());
+	}
+};
+
+class HttpParser
+	/// HttpParser finds the method, request-target and Host header of an HTTP
+	/// request without copying or allocating anything. It replaces reading the
+	/// payload into a Poco::Net::HTTPRequest, which built a stream, a
+	/// NameValueCollection and a string for every header of every packet.
+	///
+	/// Anything that doesn't start with a known method followed by a space is
+	/// rejected after looking at the first few bytes.
+{
+	public:
+		static bool parse(const char* data, size_t length,
+				HttpRequestView& request);
+			/// Parse length bytes at data into request. Returns false, and
+			/// leaves request empty, if it isn't an HTTP request. A request
+			/// whose head is cut short still returns true with the parts that
+			/// were found.
+
+		static size_t methodLength(const char* data, size_t length);
+			/// Returns the length of the method at data, or 0 if data doesn't
+			/// start with a known method followed by a space.
+
+		static const char* findHeadEnd(const char* data, size_t length);
+			/// Returns a pointer just past the empty line ending the request
+			/// head, or 0 if it isn't found within length bytes.
+};
+
+#endif // HTTPPARSER_H
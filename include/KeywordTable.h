@@ -0,0 +1,108 @@
+//
+// Library: Net Responsibility
+// Package: Core
+// Module:  KeywordTable
+//
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <KeywordTable> gives keywords and categories small IDs instead of strings
+
+
+
+#ifndef KEYWORDTABLE_H
+#define KEYWORDTABLE_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+
+#include "Poco/Types.h"
+#include "Poco/Mutex.h"
+
+/* the keywords of a match kept without allocating; more is rare */
+#define KEYWORD_HITS_INLINE 8
+
+using namespace std;
+
+class KeywordTable
+	/// KeywordTable interns the keywords and category names, so a match only
+	/// has to carry their 32-bit IDs. An ID stays the same for as long as the
+	/// application runs, also when the blacklist is reloaded, so it can be
+	/// resolved after the Filter that found it is gone. Strings are only
+	/// looked up when a report or the database needs the text.
+{
+	public:
+		static Poco::UInt32 intern(const string& text);
+			/// Returns the ID of text, adding it if it's new.
+
+		static const string& lookup(Poco::UInt32 id);
+			/// Returns the text of an ID returned by intern().
+
+	private:
+		static Poco::FastMutex _mutex;
+		static deque<string> _strings;
+			/// The text of each ID. A deque, since lookup() hands out
+			/// references that must stay valid as it grows.
+		static unordered_map<string, Poco::UInt32> _ids;
+};
+
+
+
+struct KeywordHit
+	/// One keyword found in a URL.
+{
+	Poco::UInt32 keyword;
+		/// The KeywordTable ID of the keyword as a string.
+
+	Poco::UInt32 category;
+		/// The KeywordTable ID of the category name.
+
+	Poco::Int32 strength;
+		/// The strength of the keyword.
+
+	Poco::UInt32 index;
+		/// The position of the keyword in the Filter that found it. Not
+		/// saved in the database.
+};
+
+
+
+class KeywordHits
+	/// The keywords found in a URL. The first KEYWORD_HITS_INLINE are kept
+	/// inline, so a BlacklistMatch can be copied without allocating.
+{
+	public:
+		KeywordHits();
+
+		void push_back(const KeywordHit& hit);
+
+		void clear();
+
+		size_t size() const;
+
+		bool empty() const;
+
+		const KeywordHit& operator [] (size_t i) const;
+
+	private:
+		KeywordHit _inline[KEYWORD_HITS_INLINE];
+		vector<KeywordHit> _more;
+			/// The hits after the first KEYWORD_HITS_INLINE.
+		size_t _size;
+};
+
+#endif // KEYWORDTABLE_H
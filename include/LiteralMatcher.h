@@ -0,0 +1,88 @@
+//
+// Library: Net Responsibility
+// Package: Core
+// Module:  LiteralMatcher
+//
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <LiteralMatcher> finds many literal strings in a single pass over a URL
+
+
+
+#ifndef LITERALMATCHER_H
+#define LITERALMATCHER_H
+
+#include <string>
+#include <vector>
+#include <map>
+
+/* shorter literals are found in too many URLs to be worth looking for */
+#define LITERAL_MIN_LEN 3
+
+using namespace std;
+
+class LiteralMatcher
+	/// LiteralMatcher is a case-insensitive Aho-Corasick automaton. All the
+	/// literals are added first, then compile() turns them into a complete
+	/// transition table over byte classes, so scanning a URL is one table
+	/// lookup per byte no matter how many literals there are.
+	///
+	/// Only ASCII letters are folded, just like PCRE does for caseless
+	/// patterns without UTF-8 support.
+	///
+	/// A compiled LiteralMatcher is never modified, so any number of threads
+	/// may scan with it at once.
+{
+	public:
+		LiteralMatcher();
+
+		int add(const string& literal);
+			/// Add a literal and return its id. Adding the same literal twice,
+			/// in any case, returns the same id. Must be called before compile().
+
+		void compile();
+			/// Build the automaton from every literal added.
+
+		void scan(const char* text, size_t length, vector<char>& found) const;
+			/// Set found[id] to 1 for every literal occurring in text, and to 0
+			/// for the rest.
+
+		size_t getLiteralCount() const;
+
+		size_t getStateCount() const;
+
+		static string extractLiteral(const string& pattern);
+			/// Returns the longest string, in lower case, that every match of
+			/// the regular expression pattern must contain. An empty string is
+			/// returned if there's no such string of at least LITERAL_MIN_LEN
+			/// characters, or if the pattern uses something not understood
+			/// here. Whatever is returned, it's never wrong to look for it.
+
+	private:
+		vector<string> _literals;
+		map<string, int> _ids;
+		unsigned char _class[256];
+		int _classCount;
+		vector<int> _next;
+		vector<int> _outputStart;
+		vector<int> _outputs;
+
+		static size_t skipClass(const string& pattern, size_t i);
+			/// Returns the position after the character class starting at i, or
+			/// string::npos if it isn't closed.
+};
+
+#endif // LITERALMATCHER_H
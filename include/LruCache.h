@@ -0,0 +1,208 @@
+//
+// Library: Net Responsibility
+// Package: Core
+// Module:  LruCache
+//
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <LruCache> is a sharded, fixed-capacity cache shared by several threads
+
+
+
+#ifndef LRUCACHE_H
+#define LRUCACHE_H
+
+#include <string>
+#include <list>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+
+#include "Poco/Mutex.h"
+#include "Poco/SharedPtr.h"
+#include "Poco/Types.h"
+
+using namespace std;
+
+template <class T>
+class LruCache
+	/// LruCache maps strings to values, throwing out the least recently used
+	/// entry when it's full. The entries are spread over several shards by
+	/// the hash of their key, each one with its own mutex and capacity, so
+	/// threads looking up different keys seldom wait for each other.
+	///
+	/// Only the hash of a key is indexed, but the key itself is kept and
+	/// compared as well, so two keys with the same hash never share a value.
+	///
+	/// A cache with no capacity is disabled: get() always misses and put()
+	/// does nothing.
+{
+	public:
+		LruCache()
+		{
+			setCapacity(0, 1);
+		}
+
+		void setCapacity(size_t capacity, size_t shards)
+			/// Drop every entry and make room for capacity entries in all,
+			/// spread over the given number of shards.
+		{
+			if (shards < 1)
+				shards = 1;
+			if (capacity > 0 && capacity < shards)
+				shards = capacity;
+			_shards.clear();
+			for (size_t i = 0; i < shards; i++)
+				_shards.push_back(new Shard);
+			_shardCapacity = (capacity + shards - 1) / shards;
+		}
+
+		bool get(const string& key, T& value)
+			/// Copy the value of key into value and mark it as recently used.
+			/// Returns false if key isn't cached.
+		{
+			if (_shardCapacity == 0)
+				return false;
+			size_t hash = _hasher(key);
+			Shard &shard = *_shards[hash % _shards.size()];
+			Poco::FastMutex::ScopedLock lock(shard.mutex);
+
+			typename Index::iterator it = shard.index.find(hash);
+			if (it == shard.index.end() || it->second->key != key) {
+				shard.misses++;
+				return false;
+			}
+			shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+			value = it->second->value;
+			shard.hits++;
+			return true;
+		}
+
+		void put(const string& key, const T& value)
+			/// Cache value under key, throwing out the least recently used
+			/// entry of its shard if it's full.
+		{
+			if (_shardCapacity == 0)
+				return;
+			size_t hash = _hasher(key);
+			Shard &shard = *_shards[hash % _shards.size()];
+			Poco::FastMutex::ScopedLock lock(shard.mutex);
+
+			typename Index::iterator it = shard.index.find(hash);
+			if (it != shard.index.end())
+				shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+			else {
+				/* reuse the oldest entry, with its string capacity */
+				if (shard.entries.size() >= _shardCapacity) {
+					shard.index.erase(shard.entries.back().hash);
+					shard.entries.splice(shard.entries.begin(), shard.entries,
+							--shard.entries.end());
+					shard.evictions++;
+				}
+				else
+					shard.entries.push_front(Entry());
+				shard.index[hash] = shard.entries.begin();
+			}
+			Entry &entry = shard.entries.front();
+			entry.hash = hash;
+			entry.key = key;
+			entry.value = value;
+		}
+
+		void clear()
+			/// Drop every entry. The counters are kept.
+		{
+			for (size_t i = 0; i < _shards.size(); i++) {
+				Poco::FastMutex::ScopedLock lock(_shards[i]->mutex);
+				_shards[i]->entries.clear();
+				_shards[i]->index.clear();
+			}
+		}
+
+		size_t capacity() const
+		{
+			return _shardCapacity * _shards.size();
+		}
+
+		size_t size() const
+		{
+			size_t size = 0;
+			for (size_t i = 0; i < _shards.size(); i++) {
+				Poco::FastMutex::ScopedLock lock(_shards[i]->mutex);
+				size += _shards[i]->entries.size();
+			}
+			return size;
+		}
+
+		Poco::UInt64 getHits() const
+			/// Returns the number of lookups that found their key.
+		{
+			return sum(&Shard::hits);
+		}
+
+		Poco::UInt64 getMisses() const
+			/// Returns the number of lookups that didn't find their key.
+		{
+			return sum(&Shard::misses);
+		}
+
+		Poco::UInt64 getEvictions() const
+			/// Returns the number of entries thrown out to make room for new
+			/// ones.
+		{
+			return sum(&Shard::evictions);
+		}
+
+	private:
+		struct Entry
+		{
+			size_t hash;
+			string key;
+			T value;
+		};
+
+		typedef list<Entry> Entries;
+		typedef unordered_map<size_t, typename Entries::iterator> Index;
+
+		struct Shard
+		{
+			Shard() : hits(0), misses(0), evictions(0) {}
+
+			mutable Poco::FastMutex mutex;
+			Entries entries;
+				/// The entries, most recently used first.
+			Index index;
+			Poco::UInt64 hits;
+			Poco::UInt64 misses;
+			Poco::UInt64 evictions;
+		};
+
+		vector< Poco::SharedPtr<Shard> > _shards;
+		size_t _shardCapacity;
+		std::hash<string> _hasher;
+
+		Poco::UInt64 sum(Poco::UInt64 Shard::*counter) const
+		{
+			Poco::UInt64 total = 0;
+			for (size_t i = 0; i < _shards.size(); i++) {
+				Poco::FastMutex::ScopedLock lock(_shards[i]->mutex);
+				total += (*_shards[i]).*counter;
+			}
+			return total;
+		}
+};
+
+#endif // LRUCACHE_H
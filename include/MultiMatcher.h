@@ -0,0 +1,182 @@
+//
+// Library: Net Responsibility
+// Package: Core
+// Module:  MultiMatcher
+//
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <MultiMatcher> runs many regular expressions in a single pass over a URL
+
+
+
+#ifndef MULTIMATCHER_H
+#define MULTIMATCHER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <bitset>
+
+#include "Poco/Types.h"
+
+/* limits on what a single pattern may expand to */
+#define MULTI_MAX_REPEAT 64
+#define MULTI_MAX_PATTERN_STATES 4096
+
+/* a Cache holding more than this many ints is flushed and started over */
+#define MULTI_CACHE_LIMIT (4 * 1024 * 1024)
+
+using namespace std;
+
+class MultiMatcher
+	/// MultiMatcher compiles many caseless regular expressions into a single
+	/// NFA, and runs it as a lazily built DFA. One scan of a URL tells which of
+	/// the patterns match somewhere in it, just as RegularExpression::match()
+	/// would have told for each of them.
+	///
+	/// Only a subset of the PCRE syntax is understood: literals, escapes, '.',
+	/// character classes, groups, alternation and the usual quantifiers, plus
+	/// '^' and '$' at the very beginning and end of a pattern. add() refuses
+	/// anything else, such as \b, backreferences and lookarounds, and those
+	/// patterns have to be run by PCRE instead.
+	///
+	/// The compiled NFA is never modified. The DFA states are built in a Cache
+	/// owned by the scanning thread, so any number of threads may scan at once.
+{
+	public:
+		struct Cache
+			/// The DFA states built so far by one thread. A Cache is reset
+			/// when it's used with another MultiMatcher, or when it grows
+			/// beyond MULTI_CACHE_LIMIT.
+		{
+			Cache();
+
+			Poco::UInt64 serial;
+				/// The serial of the MultiMatcher the states belong to.
+
+			vector< vector<int> > sets;
+				/// The NFA states of each DFA state, besides the ones all
+				/// states share.
+
+			vector< vector<int> > outputs;
+				/// The patterns matching when entering each DFA state.
+
+			vector< vector<int> > endOutputs;
+				/// The patterns matching if the text ends in each DFA state.
+
+			vector<int> next;
+				/// The transitions, states * classes, -1 if not built yet.
+
+			map< vector<int>, int > index;
+			vector< vector<int> > baseTargets;
+			vector<char> baseTargetsBuilt;
+			vector<unsigned int> marks;
+			unsigned int mark;
+			size_t size;
+			int initial;
+			Poco::UInt64 resets;
+		};
+
+		MultiMatcher();
+
+		int add(const string& pattern);
+			/// Add a caseless pattern and return its id, or -1 if it uses
+			/// something MultiMatcher doesn't understand. Must be called
+			/// before compile().
+
+		void compile();
+			/// Prepare the patterns added for scanning.
+
+		void scan(const char* text, size_t length, Cache& cache,
+				vector<char>& matched) const;
+			/// Set matched[id] to 1 for every pattern matching somewhere in
+			/// text, and to 0 for the rest.
+
+		size_t getPatternCount() const;
+
+		size_t getNfaStateCount() const;
+
+	private:
+		enum StateType
+		{
+			STATE_CHAR,
+				/// Consume a byte in _sets[arg], then go to out.
+
+			STATE_SPLIT,
+				/// Go to both out and out1 without consuming anything.
+
+			STATE_MATCH,
+				/// Pattern arg matched.
+
+			STATE_MATCH_END
+				/// Pattern arg matched, if this is the end of the text.
+		};
+
+		struct State
+		{
+			int type;
+			int arg;
+			int out;
+			int out1;
+		};
+
+		struct Node
+			/// A node in the syntax tree of a pattern being added.
+		{
+			enum { SET, CAT, ALT, REPEAT, EMPTY } type;
+			int set;
+			int min;
+			int max;
+			vector<int> children;
+		};
+
+		struct Fragment
+			/// A piece of the NFA with a list of dangling exits, each one
+			/// given as state * 2 + (0 for out, 1 for out1).
+		{
+			int start;
+			vector<int> exits;
+		};
+
+		class Parser;
+
+		vector<State> _states;
+		vector< bitset<256> > _sets;
+		map<string, int> _setIds;
+		vector<int> _starts;
+		vector<int> _anchoredStarts;
+		int _patternCount;
+		unsigned char _class[256];
+		unsigned char _representative[256];
+		int _classCount;
+		vector<int> _base;
+		vector<char> _isBase;
+		vector<int> _baseOutputs;
+		vector<int> _baseEndOutputs;
+		Poco::UInt64 _serial;
+
+		int internSet(const bitset<256>& set);
+		int addState(int type, int arg, int out, int out1);
+		Fragment build(const vector<Node>& nodes, int node);
+		void patch(const vector<int>& exits, int target);
+		void closure(const vector<int>& from, Cache& cache,
+				vector<int>& to) const;
+		void reset(Cache& cache) const;
+		int intern(Cache& cache, vector<int>& set) const;
+		int step(Cache& cache, int state, int c) const;
+};
+
+#endif // MULTIMATCHER_H
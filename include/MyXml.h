@@ -36,6 +36,8 @@
 #include "Poco/Logger.h"
 
 #include "Blacklist.h"
+#include "LiteralMatcher.h"
+#include "PatternCompiler.h"
 
 using Poco::AutoPtr;
 using Poco::Util::XMLConfiguration;
@@ -62,7 +64,9 @@ class MyXml : public XMLConfiguration
 			/// Returns a map<string, string> with all values found in the document.
 
 		Blacklist getBlacklist();
-			/// Extracts and compiles the keywords in the blacklist file.
+			/// Extracts and compiles the keywords in the blacklist file. The
+			/// keywords are read first, and then all their patterns are
+			/// compiled at once with a PatternCompiler.
 
 		Extensions getExtensions();
 			/// Extracts every Extension shipped with the blacklists.
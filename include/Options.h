@@ -165,6 +165,99 @@ class Options
 		int getReportStrengthThreshold() const;
 			/// Returns the report strength threshold.
 
+		string getCaptureBackend() const;
+			/// Returns which capture backend the sniffer should use. "pcap" reads
+			/// one packet at a time through libpcap, "ring" maps a TPACKET_V3
+			/// block ring (Linux only). Defaults to "pcap".
+
+		int getCaptureRingBlockSize() const;
+			/// Returns the size in bytes of each block in the capture ring.
+
+		int getCaptureRingBlocks() const;
+			/// Returns the number of blocks in the capture ring.
+
+		int getCaptureRingTimeout() const;
+			/// Returns the number of milliseconds before the kernel retires a
+			/// block that isn't full yet.
+
+		int getFilterWorkers() const;
+			/// Returns the number of FilterWorker threads.
+
+		int getFilterRingSize() const;
+			/// Returns the number of records in each ring between a
+			/// SnifferThread and a FilterWorker.
+
+		int getReassemblyFlows() const;
+			/// Returns the number of TCP flows each SnifferThread may hold
+			/// while waiting for the rest of a request head.
+
+		int getReassemblyTimeout() const;
+			/// Returns the number of seconds an unfinished request head is
+			/// kept before it's given up.
+
+		int getDbBatchSize() const;
+			/// Returns the number of URLs written to the database in a single
+			/// transaction.
+
+		int getDbBatchInterval() const;
+			/// Returns the longest time, in milliseconds, a URL may wait for
+			/// its batch to be written.
+
+		bool getDbPartitions() const;
+			/// Returns true if each reporting period is logged to a database
+			/// file of its own.
+
+		int getDbVacuumHour() const;
+			/// Returns the hour of the day, 0-23, the database gives its free
+			/// pages back to the file system, or -1 to never do it.
+
+		int getDbCoalesceWindow() const;
+			/// Returns the number of seconds repeated visits of a URL are
+			/// collapsed into one row, 0 to log every visit.
+
+		string getFilterEngine() const;
+			/// Returns how the blacklist is run: "pcre" (default) runs every
+			/// regular expression on its own, "dfa" runs all of them that it
+			/// can as one combined automaton.
+
+		bool getBlacklistSnapshot() const;
+			/// Returns true if the parsed blacklist should be saved as a
+			/// snapshot next to the XML file, and read from it at the next
+			/// start as long as the XML file is unchanged.
+
+		int getBlacklistCheckInterval() const;
+			/// Returns the number of seconds between checks for a changed
+			/// blacklist file, 0 to only reload it on SIGUSR1.
+
+		int getVerdictCacheSize() const;
+			/// Returns the number of URL verdicts Filter keeps, 0 to disable
+			/// the cache.
+
+		int getHostCacheSize() const;
+			/// Returns the number of hostnames whose history Filter keeps, to
+			/// skip filtering hosts that have never had a keyword hit. 0, the
+			/// default, disables it, since a skipped URL is never reported.
+
+		int getCacheShards() const;
+			/// Returns the number of independently locked parts each of the
+			/// Filter caches is split into.
+
+		int getDbQueueSize() const;
+			/// Returns the number of log events that may wait for the
+			/// DatabaseWriter.
+
+		string getDbQueuePolicy() const;
+			/// Returns what to do with a log event when the DatabaseWriter's
+			/// queue is full: "drop" it (default) or "block" until there's room.
+
+		int getDbCacheSize() const;
+			/// Returns the size, in KiB, of the page cache of each database
+			/// connection.
+
+		int getDbMmapSize() const;
+			/// Returns the number of MiB of the database file each connection
+			/// may read through memory mapping, 0 to disable it.
+
 		Bypasses &getInitBypasses() const;
 
 		void setUsername(string);
@@ -194,6 +287,29 @@ class Options
 		map<string, string> _txt;
 		int _reportFrequency;
 		int _reportStrengthThreshold;
+		string _captureBackend;
+		int _captureRingBlockSize;
+		int _captureRingBlocks;
+		int _captureRingTimeout;
+		int _filterWorkers;
+		int _filterRingSize;
+		int _reassemblyFlows;
+		int _reassemblyTimeout;
+		int _dbBatchSize;
+		int _dbBatchInterval;
+		int _dbCoalesceWindow;
+		int _dbVacuumHour;
+		bool _dbPartitions;
+		int _dbQueueSize;
+		string _filterEngine;
+		bool _blacklistSnapshot;
+		int _blacklistCheckInterval;
+		int _verdictCacheSize;
+		int _hostCacheSize;
+		int _cacheShards;
+		string _dbQueuePolicy;
+		int _dbCacheSize;
+		int _dbMmapSize;
 		Logger *_logger;
 		Bypasses *_initBypasses;
 
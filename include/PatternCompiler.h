@@ -0,0 +1,91 @@
+//
+// Library: Net Responsibility
+// Package: Core
+// Module:  PatternCompiler
+//
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <PatternCompiler> compiles many regular expressions on several threads
+
+
+
+#ifndef PATTERNCOMPILER_H
+#define PATTERNCOMPILER_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+
+#include "Poco/RegularExpression.h"
+#include "Poco/SharedPtr.h"
+#include "Poco/Runnable.h"
+
+/* fewer patterns than this per thread aren't worth starting a thread for */
+#define COMPILE_MIN_PATTERNS 64
+#define COMPILE_MAX_THREADS 8
+
+using Poco::RegularExpression;
+using Poco::SharedPtr;
+using namespace std;
+
+class PatternCompiler
+	/// PatternCompiler collects regular expressions first and then compiles
+	/// them all at once, on one thread per processor. The threads take the
+	/// next pattern from a shared counter, so a few slow patterns don't hold
+	/// up the rest, and every result is stored at the index add() returned,
+	/// so the outcome doesn't depend on which thread compiled what.
+{
+	public:
+		PatternCompiler(int options);
+			/// Create a compiler for patterns with the given
+			/// RegularExpression options.
+
+		size_t add(const string& pattern);
+			/// Add a pattern and return its index.
+
+		void compile();
+			/// Compile every pattern added. Returns when all are done.
+
+		SharedPtr<RegularExpression> get(size_t index) const;
+			/// Returns the compiled pattern, or a null pointer if it didn't
+			/// compile.
+
+		const string& getError(size_t index) const;
+			/// Returns the displayText() of the exception thrown when the
+			/// pattern didn't compile.
+
+	private:
+		class Task: public Poco::Runnable
+		{
+			public:
+				Task(PatternCompiler* compiler);
+				virtual void run();
+
+			private:
+				PatternCompiler *_compiler;
+		};
+
+		int _options;
+		vector<string> _patterns;
+		vector< SharedPtr<RegularExpression> > _compiled;
+		vector<string> _errors;
+		std::atomic<size_t> _next;
+
+		void compileNext();
+			/// Compile patterns until there are none left.
+};
+
+#endif // PATTERNCOMPILER_H
@@ -26,8 +26,12 @@
 #define REPORT_H
 
 #include "ReportBase.h"
+#include "AttachedReport.h"
 
 #include <map>
+#include <set>
+#include <cctype>
+#include <fstream>
 
 #ifdef _WIN32
   #ifdef BUILD_DLL
@@ -46,6 +50,7 @@
 #include "Poco/Path.h"
 #include "Poco/File.h"
 #include "Poco/NumberFormatter.h"
+#include "Poco/TemporaryFile.h"
 
 using Poco::RegularExpression;
 using Poco::DirectoryIterator;
@@ -82,17 +87,67 @@ class Report: public ReportBase
 		*/
 
 	private:
-		stringstream _attached;
+		class HistoryPaths: public HistoryHandler
+			/// Writes the history branch of every hostname to a temporary
+			/// file, and remembers where each one is, so they can be copied
+			/// to the report in any order.
+		{
+			public:
+				HistoryPaths(Report* report);
+				virtual void handleRow(const HistoryRow& row);
+
+				void getHostnames(vector<string>& hostnames) const;
+					/// Put every hostname seen in hostnames, in order.
+
+				void copy(const string& hostname, ostream& out);
+					/// Write the branch of hostname to out.
+
+			private:
+				typedef map<string, pair<streamoff, streamoff> > Ranges;
+
+				Report *_report;
+				Poco::TemporaryFile _file;
+				fstream _stream;
+				Ranges _ranges;
+					/// The start and end in _file of the branch of each
+					/// hostname.
+				Ranges::iterator _current;
+				streamoff _size;
+				string _format;
+				string _hitsFormat;
+				string _row;
+		};
+
+		AttachedReport _attached;
 		void makeBypassesSection();
 		void makeWarningsSection(string&);
 		void makeWhitelistSection();
 		void makeHistorySection();
+		void openAttachedReport();
+			/// Create the attached report and write its header.
 		void addTemplate(string suspicious = "");
 		void saveAttachedReport();
+			/// Write the footer of the attached report, and attach it.
 		string jsContent(string);
 		string makeColoredStrength(int);
 		string makeTableBranch(string, string, string anchorName = "");
 		string makeJavascriptBranch(string, string);
+		string beginJavascriptBranch(string title);
+		string endJavascriptBranch();
+			/// The parts of makeJavascriptBranch() around the content.
+
+		static void groupByDomain(const vector<string>& hostnames,
+				const set<string>& domains, map<string, vector<string> >& hosts);
+			/// Put the hostnames of each domain in hosts, in order. A hostname
+			/// belongs to every domain it matches as "hostname LIKE '%domain'",
+			/// as the history used to be queried.
+
+		static bool isLike(const char* text, const char* pattern);
+			/// Returns true if text matches pattern as in SQLite's LIKE: '%'
+			/// matches any characters, '_' one and ASCII letters match
+			/// regardless of case.
+
+		friend class ReportTest;
 };
 
 
@@ -0,0 +1,118 @@
+//
+// Library: Net Responsibility
+// Package: Core
+// Module:  RingSnifferThread
+//
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <RingSnifferThread> captures packets through a memory-mapped TPACKET_V3 ring
+
+
+
+#ifndef RINGSNIFFERTHREAD_H
+#define RINGSNIFFERTHREAD_H
+
+#include "Poco/Platform.h"
+
+#if POCO_OS == POCO_OS_LINUX
+
+#include "SnifferThread.h"
+
+#include "Poco/Timestamp.h"
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <poll.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <net/ethernet.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <linux/filter.h>
+
+using Poco::Timestamp;
+
+class RingSnifferThread: public SnifferThread
+	/// RingSnifferThread is a SnifferThread that lets the kernel write whole
+	/// blocks of frames into a ring shared with user space (AF_PACKET,
+	/// TPACKET_V3). Instead of one pcap_next_ex() call per packet, it sleeps
+	/// in poll() until a block is retired and then walks every frame in it.
+	///
+	/// The ring is tuned with captureRingBlockSize, captureRingBlocks and
+	/// captureRingTimeout in the config file. The frames per block and block
+	/// retire latency counters tell whether the blocks are too small (nearly
+	/// full blocks, low latency) or too large (few frames, latency close to
+	/// the timeout).
+{
+	public:
+		RingSnifferThread();
+			/// Constructs the thread with the ring geometry found in Options.
+
+		~RingSnifferThread();
+
+		void run();
+			/// Walk the retired blocks of the ring until stop() is called, or
+			/// an error occurs.
+
+		int openDevice(string device);
+			/// Set up the ring on the given device. "any" captures on all
+			/// interfaces, from the network header, as pcap does with
+			/// DLT_LINUX_SLL.
+
+		Poco::UInt64 getBlockCount() const;
+			/// Returns the number of blocks walked so far.
+
+		Poco::UInt64 getFrameCount() const;
+			/// Returns the number of frames walked so far.
+
+		unsigned int getMaxFramesPerBlock() const;
+			/// Returns the highest number of frames found in a single block.
+
+		double getAverageFramesPerBlock() const;
+			/// Returns the average number of frames per block.
+
+		Timestamp::TimeDiff getAverageRetireLatency() const;
+			/// Returns the average time in microseconds from the first frame
+			/// entering a block until the block was handed to us.
+
+		Timestamp::TimeDiff getMaxRetireLatency() const;
+			/// Returns the highest block retire latency in microseconds.
+
+	private:
+		int _socket;
+		bool _isCooked;
+			/// True on "any", where the frames have no link layer header.
+		u_char *_ring;
+		size_t _ringSize;
+		unsigned int _blockSize;
+		unsigned int _blockCount;
+		unsigned int _blockTimeout;
+		Poco::UInt64 _blocks;
+		Poco::UInt64 _frames;
+		unsigned int _maxFramesPerBlock;
+		Timestamp::TimeDiff _retireLatencyTotal;
+		Timestamp::TimeDiff _retireLatencyMax;
+		Timestamp _lastStats;
+
+		int attachFilter();
+		void walkBlock(struct tpacket_block_desc *block);
+		void logStats();
+		void closeRing();
+};
+
+#endif // POCO_OS_LINUX
+#endif // RINGSNIFFERTHREAD_H
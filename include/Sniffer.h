@@ -38,19 +38,24 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <atomic>
 
 #include "Poco/RegularExpression.h"
 #include "Poco/SharedPtr.h"
 #include "Poco/ThreadPool.h"
+#include "Poco/Thread.h"
+#include "Poco/Mutex.h"
 #include "Poco/Logger.h"
 #include "Poco/LogStream.h"
-#include "Poco/Net/HTTPRequest.h"
 
 #include "Database.h"
 #include "Options.h"
 #include "Filter.h"
 #include "Blacklist.h"
 #include "SnifferThread.h"
+#include "FilterWorker.h"
+#include "DatabaseWriter.h"
+#include "FilterLoader.h"
 
 #include <pcap.h>
 
@@ -63,12 +68,14 @@
 #include <arpa/inet.h>
 #endif //POCO_OS_FAMILY_
 
+/* how often run() checks whether it should stop, in milliseconds */
+#define SNIFFER_STOP_POLL 200
+
 using Poco::RegularExpression;
 using Poco::SharedPtr;
 using Poco::ThreadPool;
 using Poco::Logger;
 using Poco::LogStream;
-using Poco::Net::HTTPRequest;
 using namespace std;
 
 struct sniff_ethernet;
@@ -77,10 +84,14 @@ struct sniff_tcp;
 
 class MainApplication;
 class SnifferThread;
+class FilterWorker;
 
 class Sniffer
-	/// Sniffer sets up several SnifferThreads. One SnifferThread for each
+	/// Sniffer sets up several SnifferThreads. One SnifferThread for each
 	/// interface, or only one for the "any" interface if it's found.
+	/// The SnifferThreads only capture; the filtering and logging is done by a
+	/// pool of FilterWorkers, connected to every SnifferThread through a
+	/// lock-free UrlRing.
 	/// Much of this code is inspired by examples provided by TCPDump and Winpcap
 {
 	public:
@@ -88,22 +99,71 @@ class Sniffer
 			/// Default constructor
 
 		void run();
-			/// Run the sniffer
+			/// Run the sniffer until requestStop() is called, or every
+			/// SnifferThread has stopped. Everything it started is stopped
+			/// and deleted before it returns.
+
+		~Sniffer();
+
+		static bool requestStop();
+			/// Make run() stop the sniffer and return. Only sets a flag, so
+			/// it's safe to call from a signal handler. Returns false if no
+			/// sniffer has been created.
 
 	private:
-		Filter *_filter;
+		SharedPtr<Filter> _filter;
+		Poco::FastMutex _filterMutex;
+		std::atomic<Poco::UInt32> _filterGeneration;
+			/// Bumped every time a new Filter is published.
 		Database *_db;
 		LogStream *_logStream;
 		static Sniffer* _instance;
+		static std::atomic<bool> _isStopRequested;
 		char _errbuf[PCAP_ERRBUF_SIZE];
+		DatabaseWriter *_writer;
+		FilterLoader *_loader;
+		vector<FilterWorker*> _workers;
+		vector<SnifferThread*> _snifferThreads;
+		vector<UrlRing*> _rings;
+		Poco::Thread _writerThread;
+		Poco::Thread _loaderThread;
+		vector<Poco::Thread*> _workerThreads;
+		vector<Poco::Thread*> _captureThreads;
+
+		bool isCapturing() const;
+			/// Returns true while any SnifferThread runs.
+
+		void stop();
+			/// Stop the SnifferThreads, then the FilterLoader and the
+			/// FilterWorkers, and wait for each of them. Then stop the
+			/// DatabaseWriter and wait until it has written every URL and
+			/// logged the session stop.
+
+		static SharedPtr<Filter> getFilter();
+			/// Returns the current Filter. Takes a lock, so the FilterWorkers
+			/// keep their own reference and only call this when
+			/// getFilterGeneration() has changed.
+
+		static Poco::UInt32 getFilterGeneration();
+
+		static void publishFilter(SharedPtr<Filter> filter);
+			/// Replace the current Filter. URLs already being filtered finish
+			/// with the old one, which is deleted when the last FilterWorker
+			/// lets go of it.
 
-		static Filter& getFilter();
 		static LogStream& getLogStream();
-		static void logUrl(HTTPRequest&);
-		static void logWarning(BlacklistMatch);
+		static void logRequest(const HttpRequestView&, Poco::Int64 time,
+				bool isMatch, BlacklistMatch&);
+			/// Hand the URL, and the warning if it matched, over to the
+			/// DatabaseWriter as a single event, so the warning is connected
+			/// to the right URL even with several FilterWorkers.
 		vector<string> getDevices();
+		SnifferThread* createThread();
+			/// Create a SnifferThread for the capture backend chosen in Options.
 
 		friend class SnifferThread;
+		friend class FilterWorker;
+		friend class FilterLoader;
 };
 
 #include "MainApplication.h"
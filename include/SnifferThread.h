@@ -42,20 +42,24 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <sstream>
+#include <atomic>
 
 #include "Poco/RegularExpression.h"
 #include "Poco/SharedPtr.h"
 #include "Poco/Runnable.h"
 #include "Poco/Logger.h"
 #include "Poco/LogStream.h"
-#include "Poco/Net/HTTPRequest.h"
 #include "Poco/Exception.h"
+#include "Poco/Timestamp.h"
 
 #include "Database.h"
 #include "Options.h"
 #include "Filter.h"
 #include "Blacklist.h"
 #include "Sniffer.h"
+#include "FilterWorker.h"
+#include "HttpParser.h"
+#include "StreamReassembler.h"
 
 #include <pcap.h>
 
@@ -80,9 +84,6 @@
 /* Ethernet addresses are 6 bytes */
 #define ETHER_ADDR_LEN	6
 
-/* This TCP header length seems to work. */
-#define SIZE_TCP 22
-
 #define IP_HL(ip)               (((ip)->ip_vhl) & 0x0f)
 #define IP_V(ip)                (((ip)->ip_vhl) >> 4)
 
@@ -93,8 +94,8 @@ using Poco::RegularExpression;
 using Poco::SharedPtr;
 using Poco::Logger;
 using Poco::LogStream;
-using Poco::Net::HTTPRequest;
 using Poco::Exception;
+using Poco::Timestamp;
 using namespace std;
 
 struct sniff_ethernet;
@@ -109,24 +110,52 @@ class SnifferThread: public Poco::Runnable
 	/// Much of this code is inspired by examples provided by TCPDump and Winpcap
 {
 	public:
-		SnifferThread();
-			/// Constructs SnifferThread and sets up some default values
+		SnifferThread();
+			/// Constructs SnifferThread and sets up some default values
 
-		virtual void run();
-			/// Run the SnifferThread.
-
-		int openDevice(string device);
-			/// Open the given device.
+		virtual ~SnifferThread();
 
-	private:
-		pcap_t *_fp;
+		virtual void run();
+			/// Run the SnifferThread until stop() is called.
+
+		void stop();
+			/// Make run() return within a second, once the current packets
+			/// are handed over to the FilterWorkers.
+
+		virtual int openDevice(string device);
+			/// Open the given device.
+
+		void addRing(UrlRing* ring);
+			/// Add a ring leading to a FilterWorker. Requests are spread over
+			/// the rings by hostname, so every request to the same host ends up
+			/// in the same worker.
+
+	protected:
 		char _errbuf[PCAP_ERRBUF_SIZE];
 		char *_sniffPattern;
 		Options *_options;
-		Filter *_filter;
 		LogStream *_logStream;
+		bool _isDebugging;
+		std::atomic<bool> _isStopping;
+
+		void processPacket(const struct pcap_pkthdr*, const u_char*);
+			/// Parse one captured frame and push any HTTP request found to the
+			/// FilterWorkers. Every capture backend ends up here.
 
-		void gotPacket(const struct pcap_pkthdr*, const u_char*, HTTPRequest&);
+	private:
+		pcap_t *_fp;
+		HttpRequestView _request;
+		UrlRecord _record;
+		vector<UrlRing*> _rings;
+		StreamReassembler _reassembler;
+		Timestamp _lastReassemblyStats;
+
+		void gotPacket(const struct pcap_pkthdr*, const u_char*,
+				HttpRequestView&);
+			/// Find the HTTP request in a captured frame, if any. Requests
+			/// split over several segments are put together first.
+
+		void logReassemblyStats();
 };
 
 /* Ethernet header */
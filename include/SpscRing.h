@@ -0,0 +1,129 @@
+//
+// Library: Net Responsibility
+// Package: Core
+// Module:  SpscRing
+//
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <SpscRing> is a lock-free single-producer/single-consumer ring buffer
+
+
+
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+#define SPSC_CACHE_LINE 64
+
+template <class T>
+class SpscRing
+	/// SpscRing is a bounded, lock-free queue of fixed-size records with
+	/// exactly one producer thread and one consumer thread. The producer never
+	/// waits: when the ring is full the record is dropped and counted as an
+	/// overflow, so a slow consumer shows up as backpressure in the counters
+	/// instead of stalling packet capture.
+	///
+	/// The capacity is rounded up to a power of two.
+{
+	public:
+		SpscRing(size_t capacity)
+		{
+			size_t size = 2;
+			while (size < capacity)
+				size <<= 1;
+			_slots.resize(size);
+			_mask = size - 1;
+			_head.store(0, std::memory_order_relaxed);
+			_tail.store(0, std::memory_order_relaxed);
+			_overflows.store(0, std::memory_order_relaxed);
+			_highWater.store(0, std::memory_order_relaxed);
+		}
+
+		bool tryPush(const T& record)
+			/// Copy record into the ring. Returns false and counts an overflow
+			/// if the ring is full. May only be called by the producer.
+		{
+			size_t head = _head.load(std::memory_order_relaxed);
+			size_t tail = _tail.load(std::memory_order_acquire);
+			if (head - tail > _mask) {
+				_overflows.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+			_slots[head & _mask] = record;
+			_head.store(head + 1, std::memory_order_release);
+			if (head + 1 - tail > _highWater.load(std::memory_order_relaxed))
+				_highWater.store(head + 1 - tail, std::memory_order_relaxed);
+			return true;
+		}
+
+		T* front()
+			/// Returns the oldest record without removing it, or 0 if the ring
+			/// is empty. May only be called by the consumer.
+		{
+			size_t tail = _tail.load(std::memory_order_relaxed);
+			if (tail == _head.load(std::memory_order_acquire))
+				return 0;
+			return &_slots[tail & _mask];
+		}
+
+		void pop()
+			/// Release the record returned by front(). May only be called by
+			/// the consumer.
+		{
+			_tail.store(_tail.load(std::memory_order_relaxed) + 1,
+					std::memory_order_release);
+		}
+
+		size_t size() const
+			/// Returns the current occupancy of the ring.
+		{
+			return _head.load(std::memory_order_acquire)
+					- _tail.load(std::memory_order_acquire);
+		}
+
+		size_t capacity() const
+		{
+			return _mask + 1;
+		}
+
+		size_t getOverflows() const
+			/// Returns the number of records dropped because the ring was full.
+		{
+			return _overflows.load(std::memory_order_relaxed);
+		}
+
+		size_t getHighWater() const
+			/// Returns the highest occupancy seen so far.
+		{
+			return _highWater.load(std::memory_order_relaxed);
+		}
+
+	private:
+		SpscRing(const SpscRing&);
+		SpscRing& operator = (const SpscRing&);
+
+		std::vector<T> _slots;
+		size_t _mask;
+		alignas(SPSC_CACHE_LINE) std::atomic<size_t> _head;
+		alignas(SPSC_CACHE_LINE) std::atomic<size_t> _tail;
+		alignas(SPSC_CACHE_LINE) std::atomic<size_t> _overflows;
+		std::atomic<size_t> _highWater;
+};
+
+#endif // SPSCRING_H
@@ -0,0 +1,146 @@
+//
+// Library: Net Responsibility
+// Package: Core
+// Module:  StreamReassembler
+//
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <StreamReassembler> puts together HTTP request heads split over TCP segments
+
+
+
+#ifndef STREAMREASSEMBLER_H
+#define STREAMREASSEMBLER_H
+
+#include <vector>
+#include <cstring>
+
+#include "Poco/Types.h"
+
+#include "HttpParser.h"
+
+/* longest request head buffered for a single flow */
+#define REASSEMBLY_HEAD_LEN 4096
+
+using std::vector;
+
+struct FlowKey
+	/// Identifies a TCP flow by its IPv4 addresses and ports, in network
+	/// byte order.
+{
+	Poco::UInt32 src;
+	Poco::UInt32 dst;
+	Poco::UInt16 sport;
+	Poco::UInt16 dport;
+
+	bool operator == (const FlowKey& other) const
+	{
+		return src == other.src && dst == other.dst
+				&& sport == other.sport && dport == other.dport;
+	}
+};
+
+class StreamReassembler
+	/// StreamReassembler collects the head of an HTTP request that doesn't fit
+	/// in a single TCP segment, up to the empty line ending the headers. Only
+	/// segments following a request line are buffered, and only in order; the
+	/// body of the request is never looked at.
+	///
+	/// All memory is allocated up front: a fixed number of flows with a fixed
+	/// buffer each. When every flow is taken, the one that was idle the longest
+	/// is evicted, and flows idle for longer than the timeout are expired, so a
+	/// flood of half-sent requests costs nothing but the evictions counter.
+	///
+	/// A StreamReassembler is used by a single SnifferThread and isn't
+	/// synchronized.
+{
+	public:
+		StreamReassembler(int flows, int timeout);
+			/// Allocate room for the given number of flows, each expiring after
+			/// timeout seconds without new data.
+
+		bool add(const FlowKey& key, Poco::UInt32 seq, const char* payload,
+				size_t length, Poco::Int64 now, const char*& head,
+				size_t& headLength);
+			/// Feed one TCP segment captured at now. Returns true when a request
+			/// head is complete, with head and headLength set to it. The head
+			/// is valid until the next call. A head that doesn't fit in
+			/// REASSEMBLY_HEAD_LEN is returned as far as it was buffered.
+
+		void remove(const FlowKey& key);
+			/// Forget the flow, if any. Called when the connection is closed.
+
+		void expire(Poco::Int64 now);
+			/// Drop every flow that has been idle for longer than the timeout.
+
+		int getActive() const;
+			/// Returns the number of flows waiting for the rest of a head.
+
+		int getCapacity() const;
+			/// Returns the number of flows that can be held at once.
+
+		Poco::UInt64 getReassembled() const;
+			/// Returns the number of heads put together from several segments.
+
+		Poco::UInt64 getEvictions() const;
+			/// Returns the number of flows dropped to make room for new ones.
+
+		Poco::UInt64 getExpirations() const;
+			/// Returns the number of flows dropped because they were idle.
+
+		Poco::UInt64 getOverflows() const;
+			/// Returns the number of heads cut short at REASSEMBLY_HEAD_LEN.
+
+		Poco::UInt64 getGaps() const;
+			/// Returns the number of flows dropped because a segment was lost.
+
+	private:
+		struct Flow
+		{
+			FlowKey key;
+			Poco::UInt32 nextSeq;
+			Poco::Int64 lastSeen;
+			int length;
+			int hashNext;
+			int lruPrev;
+			int lruNext;
+			char data[REASSEMBLY_HEAD_LEN];
+		};
+
+		vector<Flow> _flows;
+		vector<int> _buckets;
+		unsigned int _bucketMask;
+		int _free;
+		int _lruHead;
+		int _lruTail;
+		int _active;
+		int _timeout;
+		Poco::Int64 _lastExpire;
+		Poco::UInt64 _reassembled;
+		Poco::UInt64 _evictions;
+		Poco::UInt64 _expirations;
+		Poco::UInt64 _overflows;
+		Poco::UInt64 _gaps;
+
+		unsigned int hash(const FlowKey& key) const;
+		int find(const FlowKey& key) const;
+		int allocate(const FlowKey& key, Poco::Int64 now);
+		void release(int index);
+		void touch(int index, Poco::Int64 now);
+		void unlinkLru(int index);
+};
+
+#endif // STREAMREASSEMBLER_H
@@ -0,0 +1,91 @@
+//
+// Library: Net Responsibility
+// Package: Core
+// Module:  UrlCoalescer
+//
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <UrlCoalescer> collapses repeated visits of a URL into one row
+
+
+
+#ifndef URLCOALESCER_H
+#define URLCOALESCER_H
+
+#include <string>
+#include <deque>
+#include <unordered_map>
+
+#include "Poco/Types.h"
+
+/* at most this many URLs are held; the oldest is let go early beyond it */
+#define URL_COALESCER_MAX_URLS 65536
+
+using namespace std;
+
+struct CoalescedUrl
+	/// A URL, and how many times it was visited within the window.
+{
+	string hostname;
+	string path;
+	Poco::Int64 time;
+		/// The first visit, as a unix timestamp.
+
+	Poco::Int64 lastSeen;
+		/// The last visit, as a unix timestamp.
+
+	int hits;
+};
+
+class UrlCoalescer
+	/// UrlCoalescer sits in front of Database::logUrl(), in the DatabaseWriter.
+	/// A URL is held for window seconds after its first visit, and every
+	/// visit of the same hostname and path meanwhile only counts a hit. Pages
+	/// that poll, or load the same image many times, then give one row
+	/// instead of one per request.
+	///
+	/// URLs that matched the blacklist aren't given to the UrlCoalescer, so
+	/// every warning keeps its own row.
+{
+	public:
+		UrlCoalescer(int window);
+			/// Hold URLs for window seconds. With a window of 0 or less
+			/// nothing is held.
+
+		bool add(const string& hostname, const string& path, Poco::Int64 time);
+			/// Count a visit at time. Returns false if the URL isn't held,
+			/// and should be logged as it is.
+
+		bool pop(CoalescedUrl& url, Poco::Int64 now, bool all = false);
+			/// Take the oldest URL whose window has passed at now, or any
+			/// URL if all is true. Returns false if there's none.
+
+		size_t size() const;
+			/// Returns the number of URLs held.
+
+	private:
+		int _window;
+		deque<CoalescedUrl> _urls;
+			/// The URLs held, in the order of their first visit.
+		Poco::UInt64 _first;
+			/// The number of URLs popped, which is the sequence number of
+			/// the first one in _urls.
+		unordered_map<string, Poco::UInt64> _seq;
+			/// The sequence number of every URL held, by hostname and path.
+		string _key;
+};
+
+#endif // URLCOALESCER_H
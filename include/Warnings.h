@@ -62,11 +62,11 @@ class Warnings: public History
 		string getAbbrUrl(int index) const;
 			/// Returns the abbreviated url of index, with matches emphasized
 
-		vector<BlacklistKeyword> getKeywords() const;
-			/// Returns all current BlacklistKeywords
+		const KeywordHits& getKeywords() const;
+			/// Returns all current keywords, see KeywordTable
 
-		vector<BlacklistKeyword> getKeywords(int index) const;
-			/// Returns all BlacklistKeywords of index
+		const KeywordHits& getKeywords(int index) const;
+			/// Returns all keywords of index, see KeywordTable
 
 	protected:
 		vector<BlacklistMatch, allocator<BlacklistMatch> > _blacklistMatches;
@@ -0,0 +1,92 @@
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <AttachedReport> writes the attached report straight to its file
+
+
+#include "AttachedReport.h"
+
+#include <sstream>
+
+#include "Poco/DateTimeFormatter.h"
+#include "Poco/DirectoryIterator.h"
+#include "Poco/Exception.h"
+#include "Poco/File.h"
+#include "Poco/RegularExpression.h"
+#include "Poco/Timestamp.h"
+#include "Poco/Zip/Compress.h"
+
+using Poco::DateTimeFormatter;
+using Poco::DirectoryIterator;
+using Poco::File;
+using Poco::RegularExpression;
+using Poco::Timestamp;
+using Poco::Zip::Compress;
+
+
+
+AttachedReport::AttachedReport() {
+}
+
+
+
+void AttachedReport::create(const string& dir) {
+	string date = DateTimeFormatter::format(Timestamp(), "%Y%m%d"),
+			iStr;
+	int i = 0, tempInt;
+	RegularExpression patt("^report_"
+			+ date + "_(\\d+)\\.(htm|zip)$", 0, true);
+	if (!File(dir).exists())
+		File(dir).createDirectory();
+	DirectoryIterator it(dir), end;
+	while (it != end) {
+		if (patt.match(it.name())) {
+			iStr = it.name();
+			patt.subst(iStr, "$1");
+			stringstream ss(iStr);
+			ss >> tempInt;
+			if (tempInt > i)
+				i = tempInt;
+		}
+		else
+			it->remove();
+		++it;
+	}
+	stringstream ss;
+	ss <<"report_" <<date <<"_" << ++i;
+	_dir = dir;
+	_name = ss.str();
+	open((_dir + _name + ".htm").c_str(), ios::out);
+	if (!is_open())
+		throw Poco::CreateFileException(_dir + _name + ".htm");
+}
+
+
+
+Path AttachedReport::finish(bool compress) {
+	string fname(_dir + _name + ".htm");
+	close();
+	if (!compress && File(fname).getSize() <= ATTACHED_REPORT_ZIP_SIZE)
+		return Path(fname);
+
+	/* Compress reads the report from the file a block at a time */
+	string zfname(_dir + _name + ".zip");
+	ofstream zipFile(zfname.c_str(), std::ios::binary);
+	Compress c(zipFile, true);
+	c.addFile(Path(fname), Path(_name + ".htm"));
+	c.close();
+	zipFile.close();
+	return Path(zfname);
+}
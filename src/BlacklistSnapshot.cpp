@@ -0,0 +1,248 @@
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <BlacklistSnapshot> saves the parsed blacklist for a faster next start
+
+
+#include "BlacklistSnapshot.h"
+
+#include <sstream>
+#include <cstring>
+
+#include "Poco/BinaryReader.h"
+#include "Poco/BinaryWriter.h"
+#include "Poco/Checksum.h"
+#include "Poco/File.h"
+#include "Poco/FileStream.h"
+#include "Poco/MemoryStream.h"
+#include "Poco/SharedMemory.h"
+#include "Poco/Util/Application.h"
+
+using Poco::BinaryReader;
+using Poco::BinaryWriter;
+using Poco::Checksum;
+using Poco::File;
+using Poco::SharedMemory;
+using Poco::Util::Application;
+
+
+
+string BlacklistSnapshot::getPath(const string& xmlPath) {
+	return xmlPath + BLACKLIST_SNAPSHOT_SUFFIX;
+}
+
+
+
+bool BlacklistSnapshot::read(const string& xmlPath, Blacklist& blacklist,
+		Extensions& extensions)
+{
+	Blacklist tempBlacklist;
+	Extensions tempExtensions;
+	Poco::UInt64 xmlSize,
+		savedXmlSize;
+	Poco::UInt32 xmlChecksum,
+		savedXmlChecksum,
+		version,
+		payloadSize,
+		payloadChecksum,
+		categories,
+		keywords,
+		patterns,
+		count;
+	Poco::Int32 strength;
+	string pattern,
+		literal;
+	char magic[4];
+	int options = RegularExpression::RE_CASELESS;
+	PatternCompiler compiler(options);
+	size_t next = 0;
+
+	try {
+		File file(getPath(xmlPath));
+		if (!file.exists() || file.getSize() < BLACKLIST_SNAPSHOT_HEADER_LEN
+				|| !checksumFile(xmlPath, xmlSize, xmlChecksum))
+			return false;
+
+		SharedMemory map(file, SharedMemory::AM_READ);
+		Poco::MemoryInputStream headerStream(map.begin(),
+				BLACKLIST_SNAPSHOT_HEADER_LEN);
+		BinaryReader header(headerStream, BinaryReader::LITTLE_ENDIAN_BYTE_ORDER);
+		header.readRaw(magic, sizeof(magic));
+		header >>version >>savedXmlSize >>savedXmlChecksum >>payloadSize
+				>>payloadChecksum;
+		if (!header.good() || memcmp(magic, BLACKLIST_SNAPSHOT_MAGIC, 4) != 0
+				|| version != BLACKLIST_SNAPSHOT_VERSION
+				|| savedXmlSize != xmlSize || savedXmlChecksum != xmlChecksum
+				|| payloadSize != (size_t)(map.end() - map.begin())
+						- BLACKLIST_SNAPSHOT_HEADER_LEN)
+			return false;
+
+		Checksum crc(Checksum::TYPE_CRC32);
+		crc.update(map.begin() + BLACKLIST_SNAPSHOT_HEADER_LEN, payloadSize);
+		if (crc.checksum() != payloadChecksum)
+			return false;
+
+		Poco::MemoryInputStream payloadStream(
+				map.begin() + BLACKLIST_SNAPSHOT_HEADER_LEN, payloadSize);
+		BinaryReader payload(payloadStream,
+				BinaryReader::LITTLE_ENDIAN_BYTE_ORDER);
+
+		payload >>categories;
+		for (Poco::UInt32 c = 0; c < categories && payload.good(); c++) {
+			tempBlacklist.push_back(BlacklistCategory());
+			payload >>tempBlacklist.back().name >>keywords;
+			for (Poco::UInt32 k = 0; k < keywords && payload.good(); k++) {
+				BlacklistKeyword keyword;
+				payload >>strength >>keyword.asString >>patterns;
+				keyword.strength = strength;
+				for (Poco::UInt32 p = 0; p < patterns && payload.good(); p++) {
+					payload >>pattern >>literal;
+					compiler.add(pattern);
+					keyword.pattern.push_back(pattern);
+					keyword.literal.push_back(literal);
+				}
+				tempBlacklist.back().keyword.push_back(keyword);
+			}
+		}
+
+		payload >>count;
+		for (Poco::UInt32 e = 0; e < count && payload.good(); e++) {
+			Extension extension;
+			payload >>strength >>extension.group >>extension.pattern;
+			extension.strength = strength;
+			extension.re = new RegularExpression(extension.pattern, options, true);
+			tempExtensions.push_back(extension);
+		}
+		if (!payload.good())
+			return false;
+
+		/* the patterns were added in blacklist order, so that's the order
+		 * they're handed out in */
+		compiler.compile();
+		for (Blacklist::iterator c = tempBlacklist.begin();
+				c != tempBlacklist.end(); c++)
+		{
+			for (vector<BlacklistKeyword>::iterator k = c->keyword.begin();
+					k != c->keyword.end(); k++)
+			{
+				for (size_t p = 0; p < k->pattern.size(); p++) {
+					k->re.push_back(compiler.get(next++));
+					if (k->re.back().isNull())
+						throw Poco::DataFormatException(compiler.getError(next - 1));
+				}
+			}
+		}
+	}
+	catch (Poco::Exception &err) {
+		Application::instance().logger().information(
+				"Couldn't read blacklist snapshot: " + err.displayText());
+		return false;
+	}
+
+	blacklist.swap(tempBlacklist);
+	extensions.swap(tempExtensions);
+	return true;
+}
+
+
+
+bool BlacklistSnapshot::write(const string& xmlPath,
+		const Blacklist& blacklist, const Extensions& extensions)
+{
+	Poco::UInt64 xmlSize;
+	Poco::UInt32 xmlChecksum;
+	string path = getPath(xmlPath),
+		tempPath = path + ".tmp";
+	if (!checksumFile(xmlPath, xmlSize, xmlChecksum))
+		return false;
+
+	ostringstream buffer;
+	BinaryWriter payload(buffer, BinaryWriter::LITTLE_ENDIAN_BYTE_ORDER);
+	payload <<(Poco::UInt32)blacklist.size();
+	for (Blacklist::const_iterator c = blacklist.begin(); c != blacklist.end(); c++) {
+		payload <<c->name <<(Poco::UInt32)c->keyword.size();
+		for (vector<BlacklistKeyword>::const_iterator k = c->keyword.begin();
+				k != c->keyword.end(); k++)
+		{
+			payload <<(Poco::Int32)k->strength <<k->asString
+					<<(Poco::UInt32)k->pattern.size();
+			for (size_t p = 0; p < k->pattern.size(); p++)
+				payload <<k->pattern[p] <<k->literal[p];
+		}
+	}
+	payload <<(Poco::UInt32)extensions.size();
+	for (Extensions::const_iterator e = extensions.begin();
+			e != extensions.end(); e++)
+	{
+		payload <<(Poco::Int32)e->strength <<e->group <<e->pattern;
+	}
+	payload.flush();
+
+	string data = buffer.str();
+	Checksum crc(Checksum::TYPE_CRC32);
+	crc.update(data);
+
+	/* write it aside and rename it, so a half-written snapshot is never read */
+	try {
+		{
+			Poco::FileOutputStream out(tempPath);
+			BinaryWriter header(out, BinaryWriter::LITTLE_ENDIAN_BYTE_ORDER);
+			header.writeRaw(BLACKLIST_SNAPSHOT_MAGIC, 4);
+			header <<(Poco::UInt32)BLACKLIST_SNAPSHOT_VERSION <<xmlSize
+					<<xmlChecksum <<(Poco::UInt32)data.length() <<crc.checksum();
+			header.writeRaw(data);
+			header.flush();
+			out.close();
+			if (!header.good())
+				throw Poco::WriteFileException(tempPath);
+		}
+		File(tempPath).renameTo(path);
+	}
+	catch (Poco::Exception &err) {
+		Application::instance().logger().information(
+				"Couldn't write blacklist snapshot: " + err.displayText());
+		try {
+			File(tempPath).remove();
+		}
+		catch (Poco::Exception &exc) {
+		}
+		return false;
+	}
+	return true;
+}
+
+
+
+bool BlacklistSnapshot::checksumFile(const string& path, Poco::UInt64& size,
+		Poco::UInt32& checksum)
+{
+	char buffer[8192];
+	Checksum crc(Checksum::TYPE_CRC32);
+	size = 0;
+	try {
+		if (!File(path).exists())
+			return false;
+		Poco::FileInputStream in(path);
+		while (in.read(buffer, sizeof(buffer)) || in.gcount() > 0) {
+			crc.update(buffer, (unsigned int)in.gcount());
+			size += in.gcount();
+		}
+	}
+	catch (Poco::Exception &err) {
+		return false;
+	}
+	checksum = crc.checksum();
+	return true;
+}
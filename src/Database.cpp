@@ -19,9 +19,37 @@
 
 #include "Database.h"
 
+#include "Poco/File.h"
+
 using namespace Poco::Data::Keywords;
 
-Database::Database() {}
+/* a HistoryRow or BypassRow takes its date and time from two columns: the
+ * start of the local day and the local time, both counted as if in UTC */
+#define LOCAL_DATE_TIME(column) "strftime('%s', " column ", 'unixepoch', " \
+		"'localtime', 'start of day'), strftime('%s', " column ", 'unixepoch', " \
+		"'localtime')"
+
+/* the columns of the history view, from urls AS u and hosts AS h */
+#define HISTORY_COLUMNS "u.rowid AS id, u.hostId AS hostId, " \
+		"h.hostname AS hostname, u.path AS path, u.time AS time, " \
+		"u.hits AS hits, u.lastSeen AS lastSeen"
+
+/* the columns a HistoryRow is extracted from, after the hostname and path */
+#define HISTORY_TIMES(prefix) LOCAL_DATE_TIME(prefix "time") ", " prefix \
+		"hits, strftime('%s', " prefix "lastSeen, 'unixepoch', 'localtime')"
+
+Database::Database() {
+	_session = _readSession = NULL;
+	_bootHistory = NULL;
+	_getLastRowId = _logUrlStatement = _logWarningStatement = NULL;
+	_logMatchStatement = _logHostStatement = _getHostIdStatement = NULL;
+	_isPartitioned = false;
+	_partitionReportId = -1;
+	_lastReportId = -1;
+	_pendingCount = 0;
+	_batchSize = 1;
+	_batchInterval = 0;
+}
 
 
 
@@ -30,25 +58,30 @@ Database::Database(Options &options)
 	_logger = &Application::instance().logger();
 	_logger->information("Connecting to database");
 	_logger->debug("Database file: " + options.getDatabasefile());
+	_pendingCount = 0;
+	_batchSize = (options.getDbBatchSize() > 0 ? options.getDbBatchSize() : 1);
+	_batchInterval = options.getDbBatchInterval();
+	_pending.resize(_batchSize);
+	_session = NULL;
+	_readSession = NULL;
+	_isPartitioned = options.getDbPartitions();
+	_databaseFile = options.getDatabasefile();
+	_partitionReportId = -1;
+	_lastReportId = -1;
 
 	const int FINISHED = 20;
 	for (int i = 0; i <= FINISHED; i++) {
 		try {
 			SQLite::Connector::registerConnector();
-			_session = new Session("SQLite", options.getDatabasefile());
-			*_session <<"CREATE TABLE IF NOT EXISTS urls "
-					<<"(hostname TEXT, path TEXT, date DATE, time TIME)", now;
-			*_session <<"CREATE TABLE IF NOT EXISTS warnings "
-					<<"(urlId INT, boldUrl TEXT, abbrUrl TEXT, strength INT, "
-					<<"whitelist INT)", now;
-			*_session <<"CREATE TABLE IF NOT EXISTS matches "
-					<<"(urlId INT, keyword TEXT, category TEXT, strength INT)", now;
-			*_session <<"CREATE TABLE IF NOT EXISTS reports "
-					<<"(type INT, date DATE, time TIME, completed INT)", now;
-			*_session <<"CREATE TABLE IF NOT EXISTS bypasses "
-					<<"(type INT, date DATE, time TIME, details TEXT)", now;
-			*_session <<"CREATE TABLE IF NOT EXISTS sessions "
-					<<"(boot DATETIME, start DATETIME, stop DATETIME)", now;
+			if (_session == NULL)
+				_session = new Session("SQLite", options.getDatabasefile());
+			setAutoVacuum();
+			setPragmas(*_session, options);
+			createTables();
+			if (_readSession == NULL)
+				_readSession = new Session("SQLite", options.getDatabasefile());
+			setPragmas(*_readSession, options);
+			*_readSession <<"PRAGMA query_only = ON", now;
 			i = FINISHED;
 		}
 		catch (DBLockedException &e) {
@@ -56,11 +89,15 @@ Database::Database(Options &options)
 				_logger->debug("Database locked, will retry to load database");
 				Thread::sleep(100);
 			}
-			else
-				_logger->warning("Database locked, couldn't load database");
+			else {
+				_logger->error("Database locked, couldn't load database");
+				throw;
+			}
 		}
 		catch (Exception &e) {
-			_logger->warning(e.displayText());
+			/* only a locked database is worth another try */
+			_logger->error(e.displayText());
+			throw;
 		}
 	}
 
@@ -74,111 +111,420 @@ Database::Database(Options &options)
 
 Database::~Database()
 {
+	/* the statements use the session, so they go first */
+	delete _getLastRowId;
+	delete _logUrlStatement;
+	delete _logWarningStatement;
+	delete _logMatchStatement;
+	delete _logHostStatement;
+	delete _getHostIdStatement;
+	delete _readSession;
+	delete _session;
+	delete _bootHistory;
 	SQLite::Connector::unregisterConnector();
 }
 
 
 
+void Database::setPragmas(Session& session, Options& options) {
+	string mode;
+	/* in WAL mode, readers and the writer don't wait for each other, and
+	 * NORMAL is enough to never corrupt the database */
+	session <<"PRAGMA journal_mode = WAL", into(mode), now;
+	if (mode != "wal")
+		_logger->warning("Couldn't use WAL for the database, using " + mode);
+	session <<"PRAGMA synchronous = NORMAL", now;
+	session <<"PRAGMA cache_size = -" <<options.getDbCacheSize(), now;
+	session <<"PRAGMA mmap_size = "
+			<<(Poco::Int64)options.getDbMmapSize() * 1024 * 1024, now;
+}
+
+
+
+void Database::beginSnapshot() {
+	/* if the partitions can't be read, the report fails */
+	attachPartitions();
+	try {
+		if (!_readSession->isTransaction())
+			_readSession->begin();
+	}
+	catch (Exception &e) {
+		_logger->warning(e.displayText());
+	}
+}
+
+
+
+void Database::endSnapshot() {
+	try {
+		if (_readSession->isTransaction())
+			_readSession->commit();
+	}
+	catch (Exception &e) {
+		_logger->warning(e.displayText());
+	}
+}
+
+
+
+void Database::createTables() {
+	int version = 0;
+	bool isUpgraded = false;
+	*_session <<"PRAGMA user_version", into(version), now;
+	if (version >= DATABASE_VERSION)
+		return;
+
+	_session->begin();
+	try {
+		if (version < 1) {
+			/* urls, reports and bypasses had a local date and time as text */
+			isUpgraded = migrateTable("urls",
+					"hostname TEXT, path TEXT, time INTEGER", "hostname, path");
+			isUpgraded = migrateTable("reports",
+					"type INT, time INTEGER, completed INT", "type, completed")
+					|| isUpgraded;
+			isUpgraded = migrateTable("bypasses",
+					"type INT, time INTEGER, details TEXT", "type, details")
+					|| isUpgraded;
+		}
+		if (version < 2)
+			isUpgraded = migrateHosts() || isUpgraded;
+		if (version < 3)
+			isUpgraded = migrateHits() || isUpgraded;
+		*_session <<"CREATE TABLE IF NOT EXISTS hosts (hostname TEXT UNIQUE)", now;
+		*_session <<"CREATE TABLE IF NOT EXISTS urls (hostId INTEGER, path TEXT, "
+				<<"time INTEGER, hits INTEGER DEFAULT 1, lastSeen INTEGER)", now;
+		*_session <<"CREATE TABLE IF NOT EXISTS warnings "
+				<<"(urlId INT, boldUrl TEXT, abbrUrl TEXT, strength INT, "
+				<<"whitelist INT)", now;
+		*_session <<"CREATE TABLE IF NOT EXISTS matches "
+				<<"(urlId INT, keyword TEXT, category TEXT, strength INT)", now;
+		*_session <<"CREATE TABLE IF NOT EXISTS reports "
+				<<"(type INT, time INTEGER, completed INT)", now;
+		*_session <<"CREATE TABLE IF NOT EXISTS bypasses "
+				<<"(type INT, time INTEGER, details TEXT)", now;
+		*_session <<"CREATE TABLE IF NOT EXISTS sessions "
+				<<"(boot DATETIME, start DATETIME, stop DATETIME)", now;
+		*_session <<"CREATE TABLE IF NOT EXISTS rotations "
+				<<"(time INTEGER, nextId INTEGER)", now;
+		*_session <<"CREATE TABLE IF NOT EXISTS partitions "
+				<<"(file TEXT, reportId INT, created INTEGER)", now;
+		*_session <<"CREATE INDEX IF NOT EXISTS urls_time ON urls (time)", now;
+		*_session <<"CREATE INDEX IF NOT EXISTS urls_hostId "
+				<<"ON urls (hostId)", now;
+		*_session <<"CREATE INDEX IF NOT EXISTS warnings_urlId "
+				<<"ON warnings (urlId)", now;
+		*_session <<"CREATE INDEX IF NOT EXISTS matches_urlId "
+				<<"ON matches (urlId)", now;
+		*_session <<"CREATE INDEX IF NOT EXISTS bypasses_time "
+				<<"ON bypasses (time)", now;
+		/* the urls as they were before the hosts table, for the queries */
+		*_session <<"CREATE VIEW IF NOT EXISTS history AS SELECT " HISTORY_COLUMNS
+				<<" FROM urls AS u JOIN hosts AS h ON u.hostId = h.rowid", now;
+		*_session <<"PRAGMA user_version = " <<DATABASE_VERSION, now;
+		_session->commit();
+	}
+	catch (Exception &e) {
+		rollback();
+		throw;
+	}
+
+	if (!isUpgraded)
+		return;
+	stringstream msg;
+	msg <<"Database schema upgraded to version " <<DATABASE_VERSION;
+	_logger->information(msg.str());
+}
+
+
+
+void Database::setAutoVacuum() {
+	int tables = 0;
+	*_session <<"SELECT COUNT() FROM sqlite_master", into(tables), now;
+	/* only a new database takes the mode without a VACUUM, and only until
+	 * WAL is turned on; any other is converted by convertAutoVacuum() */
+	if (tables == 0)
+		*_session <<"PRAGMA auto_vacuum = INCREMENTAL", now;
+}
+
+
+
+bool Database::migrateTable(const string& table, const string& columns,
+		const string& kept)
+{
+	int count = 0;
+	*_session <<"SELECT COUNT() FROM sqlite_master WHERE type = 'table' "
+			<<"AND name = :name", use(table), into(count), now;
+	if (count == 0)
+		return false;
+
+	/* the rowids are kept, since warnings and matches refer to them */
+	*_session <<"ALTER TABLE " <<table <<" RENAME TO " <<table <<"_old", now;
+	*_session <<"CREATE TABLE " <<table <<" (" <<columns <<")", now;
+	*_session <<"INSERT INTO " <<table <<" (rowid, " <<kept <<", time) "
+			<<"SELECT rowid, " <<kept <<", "
+			<<"strftime('%s', date || ' ' || time, 'utc') FROM " <<table <<"_old",
+			now;
+	*_session <<"DROP TABLE " <<table <<"_old", now;
+	return true;
+}
+
+
+
+bool Database::migrateHosts() {
+	int count = 0;
+	*_session <<"SELECT COUNT() FROM sqlite_master WHERE type = 'table' "
+			<<"AND name = 'urls'", into(count), now;
+	if (count == 0)
+		return false;
+
+	*_session <<"ALTER TABLE urls RENAME TO urls_old", now;
+	*_session <<"CREATE TABLE hosts (hostname TEXT UNIQUE)", now;
+	*_session <<"INSERT INTO hosts (hostname) "
+			<<"SELECT DISTINCT IFNULL(hostname, '') FROM urls_old", now;
+	*_session <<"CREATE TABLE urls (hostId INTEGER, path TEXT, time INTEGER)",
+			now;
+	*_session <<"INSERT INTO urls (rowid, hostId, path, time) "
+			<<"SELECT u.rowid, h.rowid, u.path, u.time FROM urls_old AS u "
+			<<"JOIN hosts AS h ON h.hostname = IFNULL(u.hostname, '')", now;
+	*_session <<"DROP TABLE urls_old", now;
+	return true;
+}
+
+
+
+bool Database::migrateHits() {
+	int count = 0;
+	*_session <<"SELECT COUNT() FROM sqlite_master WHERE type = 'table' "
+			<<"AND name = 'urls'", into(count), now;
+	if (count == 0)
+		return false;
+
+	*_session <<"ALTER TABLE urls ADD COLUMN hits INTEGER DEFAULT 1", now;
+	*_session <<"ALTER TABLE urls ADD COLUMN lastSeen INTEGER", now;
+	*_session <<"UPDATE urls SET lastSeen = time", now;
+	/* created again with the new columns */
+	*_session <<"DROP VIEW IF EXISTS history", now;
+	return true;
+}
+
+
+
+int Database::getHostId(const string& hostname) {
+	unordered_map<string, int>::const_iterator it = _hostIds.find(hostname);
+	if (it != _hostIds.end())
+		return it->second;
+
+	/* only the first URL of a host in this process gets here */
+	_hostname = hostname;
+	_logHostStatement->execute();
+	_getHostIdStatement->execute();
+	_hostIds[hostname] = _hostId;
+	return _hostId;
+}
+
+
+
 void Database::setStatements() {
 	_getLastRowId = new Statement(*_session);
 	_logUrlStatement = new Statement(*_session);
 	_logWarningStatement = new Statement(*_session);
 	_logMatchStatement = new Statement(*_session);
+	_logHostStatement = new Statement(*_session);
+	_getHostIdStatement = new Statement(*_session);
+	/* with partitions, URLs are logged to the one attached as current */
+	string schema = (_isPartitioned ? "current." : "main.");
 	*_getLastRowId <<"SELECT last_insert_rowid()", into(_lastRowId);
-	*_logUrlStatement <<"INSERT INTO urls VALUES "
-			<<"(:hostname, :path, date(:date, 'unixepoch', 'localtime'), "
-			<<"time(:time, 'unixepoch', 'localtime'))",
-			use(_hostname), use(_path), use(_date), use(_time);
-	*_logWarningStatement <<"INSERT INTO warnings VALUES "
+	*_logUrlStatement <<"INSERT INTO " <<schema <<"urls "
+			<<"(hostId, path, time, hits, lastSeen) "
+			<<"VALUES (:hostId, :path, :time, :hits, :lastSeen)",
+			use(_hostId), use(_path), use(_time), use(_hits), use(_lastSeen);
+	*_logHostStatement <<"INSERT OR IGNORE INTO hosts (hostname) "
+			<<"VALUES (:hostname)", use(_hostname);
+	*_getHostIdStatement <<"SELECT rowid FROM hosts WHERE hostname = :hostname",
+			use(_hostname), into(_hostId);
+	*_logWarningStatement <<"INSERT INTO " <<schema <<"warnings VALUES "
 			<<"(:urlId, :boldUrl, :abbrUrl, :strength, :whitelist)",
 			use(_lastRowId), use(_blacklistMatch);
-	*_logMatchStatement <<"INSERT INTO matches VALUES "
+	*_logMatchStatement <<"INSERT INTO " <<schema <<"matches VALUES "
 			<<"(:urlId, :keyword, :category, :strength)",
 			use(_lastRowId), use(_keyword), use(_category), use(_strength);
 }
 
 
-void Database::logUrl(HTTPRequest& request)
+void Database::logUrl(const HttpRequestView& request, Poco::Int64 time,
+		int hits, Poco::Int64 lastSeen)
 {
-	const int FINISHED = 10;
-	for (int i = 0; i <= FINISHED; i++) {
-		try {
-			_hostname = request.getHost();
-			_path = request.getURI();
-			_timestamp.update();
-			_date = _time = _timestamp.epochTime();
-			_logUrlStatement->execute();
-			_getLastRowId->execute();
-			i = FINISHED;
-		}
-		catch (DBLockedException &e) {
-			if (i < FINISHED) {
-				_logger->debug("Database locked, will retry to log URL");
-				Thread::sleep(i * 1000);
-			}
-			else
-				_logger->warning("Database locked, couldn't log URL");
-		}
-		catch (Exception &e) {
-			_logger->warning(e.displayText());
-		}
+	if (_pendingCount == _pending.size())
+		_pending.resize(_pendingCount + 1);
+	PendingUrl &url = _pending[_pendingCount++];
+	url.hostname.assign(request.host.data(), request.host.length());
+	url.path.assign(request.target.data(), request.target.length());
+	url.time = time;
+	url.hits = hits;
+	url.lastSeen = (lastSeen > 0 ? lastSeen : time);
+	url.isWarning = false;
+	if (_pendingCount == 1)
+		_pendingSince.update();
+}
+
+
+
+void Database::logWarning(const BlacklistMatch& match)
+{
+	if (_pendingCount == 0) {
+		_logger->warning("No URL to connect the warning to");
+		return;
 	}
+	PendingUrl &url = _pending[_pendingCount - 1];
+	url.match = match;
+	url.isWarning = true;
 }
 
 
 
-void Database::logWarning(BlacklistMatch match)
+void Database::flushUrls(bool force)
 {
+	if (_pendingCount == 0)
+		return;
+	if (!force && (int)_pendingCount < _batchSize
+			&& !_pendingSince.isElapsed((Timestamp::TimeDiff)_batchInterval * 1000))
+		return;
+
+	Timestamp start;
+	bool isWritten = false,
+		isRejected = false;
 	const int FINISHED = 10;
 	for (int i = 0; i <= FINISHED; i++) {
 		try {
-			_blacklistMatch = match;
-			_logWarningStatement->execute();
-			logMatch(match);
+			if (_isPartitioned)
+				usePartition();
+			_session->begin();
+			for (size_t u = 0; u < _pendingCount; u++)
+				writeUrl(_pending[u]);
+			_session->commit();
+			isWritten = true;
 			i = FINISHED;
 		}
 		catch (DBLockedException &e) {
+			rollback();
 			if (i < FINISHED) {
-				_logger->debug("Database locked, will retry to log warning");
+				_logger->debug("Database locked, will retry to log URLs");
 				Thread::sleep(i * 1000);
 			}
 			else
-				_logger->warning("Database locked, couldn't log warning");
+				_logger->warning("Database locked, will log the URLs later");
 		}
 		catch (Exception &e) {
+			rollback();
 			_logger->warning(e.displayText());
+			isRejected = true;
+			i = FINISHED;
 		}
 	}
+
+	/* one bad row mustn't take the whole batch with it */
+	if (isRejected)
+		isWritten = replayUrls();
+	/* otherwise the batch is kept, and tried again by the next flush */
+	if (!isWritten)
+		return;
+
+	if (!isRejected) {
+		stringstream msg;
+		msg <<"Logged " <<_pendingCount <<" URLs in one transaction, in "
+				<<start.elapsed() / 1000 <<" ms";
+		_logger->debug(msg.str());
+	}
+	_pendingCount = 0;
 }
 
 
 
-void Database::logMatch(BlacklistMatch match) {
-	const int FINISHED = 10;
-	for (std::vector<BlacklistKeyword>::iterator it = match.keyword.begin();
-			it != match.keyword.end(); it++)
-	{
-		for (int i = 0; i <= FINISHED; i++) {
+bool Database::replayUrls() {
+	size_t lost = 0,
+		u = 0;
+	bool isDone = true;
+	try {
+		if (_isPartitioned)
+			usePartition();
+		for (; u < _pendingCount; u++) {
 			try {
-				_keyword = it->asString;
-				_category = it->category;
-				_strength = it->strength;
-				_logMatchStatement->execute();
-				i = FINISHED;
+				_session->begin();
+				writeUrl(_pending[u]);
+				_session->commit();
 			}
 			catch (DBLockedException &e) {
-				if (i < FINISHED) {
-					_logger->debug("Database locked, will retry to log blacklist match");
-					Thread::sleep(i * 1000);
-				}
-				else
-					_logger->warning("Database locked, couldn't log blacklist match");
+				throw;
 			}
 			catch (Exception &e) {
-				_logger->warning(e.displayText());
+				rollback();
+				lost++;
 			}
 		}
 	}
+	catch (Exception &e) {
+		/* what's written is written, the rest waits for the next flush */
+		rollback();
+		_logger->warning("Couldn't log URLs, will try again later: "
+				+ e.displayText());
+		for (size_t k = u; k < _pendingCount; k++)
+			swap(_pending[k - u], _pending[k]);
+		_pendingCount -= u;
+		isDone = false;
+	}
+
+	if (lost > 0) {
+		stringstream msg;
+		msg <<"Couldn't log " <<lost <<" URL" <<(lost > 1 ? "s" : "")
+				<<", dropped";
+		_logger->warning(msg.str());
+	}
+	return isDone;
+}
+
+
+
+void Database::writeUrl(const PendingUrl& url) {
+	_hostId = getHostId(url.hostname);
+	_path = url.path;
+	_time = url.time;
+	_hits = url.hits;
+	_lastSeen = url.lastSeen;
+	_logUrlStatement->execute();
+	if (url.isWarning) {
+		/* still inside the transaction, so this is our URL */
+		_getLastRowId->execute();
+		_blacklistMatch = url.match;
+		_logWarningStatement->execute();
+		logMatch(url.match);
+	}
+}
+
+
+
+void Database::logMatch(const BlacklistMatch& match) {
+	for (size_t i = 0; i < match.keyword.size(); i++) {
+		const KeywordHit &hit = match.keyword[i];
+		_keyword = KeywordTable::lookup(hit.keyword);
+		_category = KeywordTable::lookup(hit.category);
+		_strength = hit.strength;
+		_logMatchStatement->execute();
+	}
+}
+
+
+
+void Database::rollback() {
+	/* hosts added in the transaction are gone with it */
+	_hostIds.clear();
+	try {
+		if (_session->isTransaction())
+			_session->rollback();
+	}
+	catch (Exception &e) {
+		_logger->warning(e.displayText());
+	}
 }
 
 
@@ -210,14 +556,12 @@ void Database::logBypass(int type, string details, int datetime) {
 		try {
 			if (datetime == 0) {
 				*_session <<"INSERT INTO bypasses VALUES "
-						<<"(:type, date('now', 'localtime')"
-						<<", time('now', 'localtime'), :details)",
+						<<"(:type, strftime('%s', 'now'), :details)",
 						use(type), use(details), now;
 			}
 			else {
 				*_session <<"INSERT INTO bypasses VALUES "
-						<<"(:type, date(:datetime, 'unixepoch', 'localtime')"
-						<<", time(:datetime, 'unixepoch', 'localtime'), :details)",
+						<<"(:type, :datetime, :details)",
 						use(type), use(datetime), use(details), now;
 
 			}
@@ -249,9 +593,7 @@ void Database::logInitBypasses(Bypasses &bypasses) {
 		for (int i = 0; i <= FINISHED; i++) {
 			try {
 				*_session <<"INSERT INTO bypasses VALUES (:type, "
-						<<"date(:date, 'unixepoch', 'localtime'), "
-						<<"time(:time, 'unixepoch', 'localtime'), "
-						<<":details)", use(type), now;
+						<<":time, :details)", use(type), now;
 				i = FINISHED;
 			}
 			catch (DBLockedException &e) {
@@ -278,9 +620,11 @@ void Database::logReportStart(int &id) {
 	for (int i = 0; i <= FINISHED; i++) {
 		try {
 			*_session <<"INSERT INTO reports VALUES "
-					<<"(:type, date('now', 'localtime'), time('now', 'localtime'), 0)",
+					<<"(:type, strftime('%s', 'now'), 0)",
 					use(type), now;
 			id = getLastRowId();
+			/* URLs logged from now on go to the partition of this report */
+			_lastReportId = id;
 			i = FINISHED;
 		}
 		catch (DBLockedException &e) {
@@ -503,21 +847,153 @@ void Database::processPreviousSessions() {
 
 
 void Database::rotateLog(int reportId) {
-	int datetime;
+	Poco::Int64 datetime = 0;
+	const int FINISHED = 30;
+	for (int i = 0; i <= FINISHED; i++) {
+		try {
+			*_session <<"SELECT time FROM reports WHERE rowid=:id",
+					use(reportId), into(datetime), now;
+			i = FINISHED;
+		}
+		catch (DBLockedException &e) {
+			if (i < FINISHED) {
+				_logger->debug("Database locked, will retry to rotate the log");
+				Thread::sleep(200);
+			}
+			else {
+				_logger->warning("Database locked, couldn't rotate the log");
+				return;
+			}
+		}
+		catch (Exception &e) {
+			_logger->warning(e.displayText());
+			return;
+		}
+	}
+	rotate(datetime);
+}
+
+
+
+void Database::resumeRotation() {
+	std::vector<Poco::Int64> datetime;
+	try {
+		*_session <<"SELECT time FROM rotations", into(datetime), now;
+	}
+	catch (Exception &e) {
+		_logger->warning(e.displayText());
+		return;
+	}
+	if (datetime.size() == 1)
+		rotate(datetime[0]);
+}
+
+
+
+void Database::rotate(Poco::Int64 datetime) {
+	std::vector<string> schemas(1, "main");
+	string boundary;
+	int start = 0, last = 0;
+	bool isStarted = false, isDropped = false;
 	const int FINISHED = 30;
 	for (int i = 0; i <= FINISHED; i++) {
 		try {
-			*_session <<"SELECT strftime('%s', date) + (strftime('%s', time) % 86400) "
-					<<"FROM reports WHERE rowid=:id", use(reportId), into(datetime), now;
-			string condition = " WHERE strftime('%s', date) +"
-					" (strftime('%s', time) % 86400) < :datetime";
-			*_session <<"DELETE FROM matches WHERE urlId IN (SELECT rowid FROM urls"
-					<<condition <<")", use(datetime), now;
-			*_session <<"DELETE FROM warnings WHERE urlId IN (SELECT rowid FROM urls"
-					<<condition <<")", use(datetime), now;
-			*_session <<"DELETE FROM urls" <<condition, use(datetime), now;
-			*_session <<"DELETE FROM bypasses" <<condition, use(datetime), now;
+			if (_isPartitioned && !isDropped) {
+				boundary = dropPartitions(datetime);
+				isDropped = true;
+			}
+			if (!boundary.empty() && schemas.size() == 1) {
+				/* a file can't be attached twice to a session */
+				if (boundary == _partitionFile)
+					schemas.push_back("current");
+				else {
+					*_session <<"ATTACH DATABASE :file AS rotated", use(boundary),
+							now;
+					schemas.push_back("rotated");
+				}
+			}
+			startRotation(datetime, schemas, start, last);
+			isStarted = true;
+			i = FINISHED;
+		}
+		catch (DBLockedException &e) {
+			rollback();
+			if (i < FINISHED) {
+				_logger->debug("Database locked, will retry to rotate the log");
+				Thread::sleep(200);
+			}
+			else
+				_logger->warning("Database locked, couldn't rotate the log");
+		}
+		catch (Exception &e) {
+			rollback();
+			_logger->warning(e.displayText());
+			i = FINISHED;
+		}
+	}
 
+	/* each chunk of rowids is deleted in a transaction of its own, so the
+	 * sniffer only waits for one chunk at a time */
+	int lo = start, hi, next;
+	std::vector<Statement> deletes;
+	string condition = " WHERE rowid BETWEEN :lo AND :hi AND time < :datetime";
+	for (size_t s = 0; s < schemas.size(); s++) {
+		string urls = schemas[s] + ".urls";
+		Statement deleteMatches(*_session), deleteWarnings(*_session),
+				deleteUrls(*_session);
+		deleteMatches <<"DELETE FROM " <<schemas[s] <<".matches WHERE urlId IN "
+				<<"(SELECT rowid FROM " <<urls <<condition <<")",
+				use(lo), use(hi), use(datetime);
+		deleteWarnings <<"DELETE FROM " <<schemas[s] <<".warnings WHERE urlId IN "
+				<<"(SELECT rowid FROM " <<urls <<condition <<")",
+				use(lo), use(hi), use(datetime);
+		deleteUrls <<"DELETE FROM " <<urls <<condition,
+				use(lo), use(hi), use(datetime);
+		deletes.push_back(deleteMatches);
+		deletes.push_back(deleteWarnings);
+		deletes.push_back(deleteUrls);
+	}
+	Statement saveRotation(*_session);
+	saveRotation <<"UPDATE rotations SET nextId = :next", use(next);
+	bool isDone = isStarted;
+	for (; isDone && lo <= last; lo = next) {
+		hi = lo + DATABASE_ROTATE_ROWS - 1;
+		next = hi + 1;
+		for (int i = 0; i <= FINISHED; i++) {
+			try {
+				_session->begin();
+				for (size_t d = 0; d < deletes.size(); d++)
+					deletes[d].execute();
+				saveRotation.execute();
+				_session->commit();
+				i = FINISHED;
+			}
+			catch (DBLockedException &e) {
+				rollback();
+				if (i < FINISHED) {
+					_logger->debug("Database locked, will retry to rotate the log");
+					Thread::sleep(200);
+				}
+				else {
+					/* the next rotation goes on from this chunk */
+					_logger->warning("Database locked, couldn't rotate the log");
+					isDone = false;
+				}
+			}
+			catch (Exception &e) {
+				rollback();
+				_logger->warning(e.displayText());
+				isDone = false;
+				i = FINISHED;
+			}
+		}
+	}
+
+	for (int i = 0; isDone && i <= FINISHED; i++) {
+		try {
+			*_session <<"DELETE FROM bypasses WHERE time < :datetime",
+					use(datetime), now;
+			*_session <<"DELETE FROM rotations", now;
 			i = FINISHED;
 		}
 		catch (DBLockedException &e) {
@@ -530,7 +1006,341 @@ void Database::rotateLog(int reportId) {
 		}
 		catch (Exception &e) {
 			_logger->warning(e.displayText());
+			i = FINISHED;
+		}
+	}
+
+	if (schemas.size() > 1 && schemas[1] == "rotated") {
+		deletes.clear();
+		try {
+			*_session <<"DETACH DATABASE rotated", now;
+		}
+		catch (Exception &e) {
+			_logger->warning(e.displayText());
+		}
+	}
+}
+
+
+
+void Database::startRotation(Poco::Int64 datetime,
+		const std::vector<string>& schemas, int& start, int& last)
+{
+	std::vector<Poco::Int64> time;
+	std::vector<int> nextId;
+	int first, max;
+	start = last = 0;
+	for (size_t s = 0; s < schemas.size(); s++) {
+		*_session <<"SELECT IFNULL(MAX(rowid), 0) FROM " <<schemas[s] <<".urls "
+				<<"WHERE time < :datetime", use(datetime), into(max), now;
+		if (max > last)
+			last = max;
+	}
+	*_session <<"SELECT time, nextId FROM rotations", into(time), into(nextId),
+			now;
+	if (time.size() == 1 && time[0] == datetime) {
+		_logger->information("Resuming the rotation of the log");
+		start = nextId[0];
+		return;
+	}
+
+	/* a later rotation deletes everything an unfinished one would have */
+	for (size_t s = 0; s < schemas.size(); s++) {
+		*_session <<"SELECT IFNULL(MIN(rowid), 0) FROM " <<schemas[s] <<".urls",
+				into(first), now;
+		if (first > 0 && (start == 0 || first < start))
+			start = first;
+	}
+	_session->begin();
+	*_session <<"DELETE FROM rotations", now;
+	*_session <<"INSERT INTO rotations VALUES (:datetime, :start)",
+			use(datetime), use(start), now;
+	_session->commit();
+}
+
+
+
+string Database::dropPartitions(Poco::Int64 datetime) {
+	std::vector<int> rowid;
+	std::vector<string> file;
+	std::vector<Poco::Int64> created;
+	string boundary;
+	int dropped = 0;
+
+	/* the report may have them open */
+	detachPartitions();
+	*_session <<"SELECT rowid, file, created FROM partitions ORDER BY rowid",
+			into(rowid), into(file), into(created), now;
+	for (size_t p = 0; p < file.size() && created[p] < datetime; p++) {
+		/* every URL of a partition was logged before the next one was
+		 * created, so if that's before datetime the whole file can go */
+		if (p + 1 == file.size() || created[p + 1] > datetime) {
+			boundary = file[p];
+			continue;
+		}
+		*_session <<"DELETE FROM partitions WHERE rowid = :rowid",
+				use(rowid[p]), now;
+		removePartition(file[p]);
+		dropped++;
+	}
+	if (dropped > 0) {
+		stringstream msg;
+		msg <<"Dropped " <<dropped <<" partitions of the log";
+		_logger->information(msg.str());
+	}
+	return boundary;
+}
+
+
+
+void Database::removePartition(const string& file) {
+	const char *suffix[] = {"", "-wal", "-shm", "-journal"};
+	for (int s = 0; s < 4; s++) {
+		try {
+			Poco::File f(file + suffix[s]);
+			if (f.exists())
+				f.remove();
+		}
+		catch (Exception &e) {
+			_logger->warning(e.displayText());
+		}
+	}
+}
+
+
+
+void Database::mergePartition() {
+	std::vector<int> rowid;
+	std::vector<string> file;
+	int count = 0;
+	*_session <<"SELECT rowid, file FROM partitions ORDER BY rowid",
+			into(rowid), into(file), now;
+	if (file.size() < DATABASE_MAX_PARTITIONS)
+		return;
+
+	if (isAttached("merged"))
+		*_session <<"DETACH DATABASE merged", now;
+	*_session <<"ATTACH DATABASE :file AS merged", use(file[0]), now;
+	try {
+		_session->begin();
+		/* a rotation may have dropped it meanwhile */
+		*_session <<"SELECT COUNT() FROM partitions WHERE rowid = :rowid",
+				use(rowid[0]), into(count), now;
+		if (count > 0) {
+			*_session <<"INSERT INTO main.urls "
+					<<"(rowid, hostId, path, time, hits, lastSeen) "
+					<<"SELECT id, hostId, path, time, hits, lastSeen "
+					<<"FROM merged.urls", now;
+			*_session <<"INSERT INTO main.warnings SELECT * FROM merged.warnings",
+					now;
+			*_session <<"INSERT INTO main.matches SELECT * FROM merged.matches",
+					now;
+			*_session <<"DELETE FROM partitions WHERE rowid = :rowid",
+					use(rowid[0]), now;
 		}
+		_session->commit();
+	}
+	catch (...) {
+		rollback();
+		*_session <<"DETACH DATABASE merged", now;
+		throw;
+	}
+	*_session <<"DETACH DATABASE merged", now;
+	removePartition(file[0]);
+	if (count > 0)
+		_logger->information("Merged " + file[0] + " into the main database");
+}
+
+
+
+bool Database::isAttached(const string& schema) {
+	int count = 0;
+	*_session <<"SELECT COUNT() FROM pragma_database_list WHERE name = :schema",
+			use(schema), into(count), now;
+	return count > 0;
+}
+
+
+
+void Database::usePartition() {
+	int lastId = 0, seq = 0;
+	if (_lastReportId < 0)
+		*_session <<"SELECT IFNULL(MAX(rowid), 0) FROM reports",
+				into(_lastReportId), now;
+	int reportId = _lastReportId;
+	if (reportId == _partitionReportId)
+		return;
+
+	/* a failed try may have left it attached, whatever _partitionReportId
+	 * says */
+	bool isCurrent = isAttached("current");
+	std::vector<string> file;
+	*_session <<"SELECT file FROM partitions WHERE reportId = :id",
+			use(reportId), into(file), now;
+	if (file.empty()) {
+		mergePartition();
+		/* the rowids go on from the last partition, so a URL has the same
+		 * ID whichever partitions are attached */
+		*_session <<"SELECT IFNULL(MAX(rowid), 0) FROM main.urls", into(lastId),
+				now;
+		if (!isCurrent) {
+			*_session <<"SELECT file FROM partitions ORDER BY rowid DESC LIMIT 1",
+					into(file), now;
+			if (!file.empty()) {
+				*_session <<"ATTACH DATABASE :file AS current", use(file[0]), now;
+				isCurrent = true;
+			}
+		}
+		if (isCurrent) {
+			*_session <<"SELECT IFNULL((SELECT seq FROM current.sqlite_sequence "
+					<<"WHERE name = 'urls'), 0)", into(seq), now;
+			if (seq > lastId)
+				lastId = seq;
+		}
+		stringstream name;
+		name <<_databaseFile <<"." <<reportId;
+		file.assign(1, name.str());
+	}
+	if (isCurrent)
+		*_session <<"DETACH DATABASE current", now;
+	_partitionReportId = -1;
+	_partitionFile = "";
+
+	*_session <<"ATTACH DATABASE :file AS current", use(file[0]), now;
+	*_session <<"PRAGMA current.journal_mode = WAL", now;
+	*_session <<"CREATE TABLE IF NOT EXISTS current.urls "
+			<<"(id INTEGER PRIMARY KEY AUTOINCREMENT, hostId INTEGER, path TEXT, "
+			<<"time INTEGER, hits INTEGER DEFAULT 1, lastSeen INTEGER)", now;
+	*_session <<"CREATE TABLE IF NOT EXISTS current.warnings "
+			<<"(urlId INT, boldUrl TEXT, abbrUrl TEXT, strength INT, "
+			<<"whitelist INT)", now;
+	*_session <<"CREATE TABLE IF NOT EXISTS current.matches "
+			<<"(urlId INT, keyword TEXT, category TEXT, strength INT)", now;
+	*_session <<"CREATE INDEX IF NOT EXISTS current.urls_time ON urls (time)",
+			now;
+	*_session <<"CREATE INDEX IF NOT EXISTS current.urls_hostId "
+			<<"ON urls (hostId)", now;
+	*_session <<"CREATE INDEX IF NOT EXISTS current.warnings_urlId "
+			<<"ON warnings (urlId)", now;
+	*_session <<"CREATE INDEX IF NOT EXISTS current.matches_urlId "
+			<<"ON matches (urlId)", now;
+	*_session <<"INSERT INTO current.sqlite_sequence (name, seq) "
+			<<"SELECT 'urls', :lastId WHERE NOT EXISTS "
+			<<"(SELECT 1 FROM current.sqlite_sequence WHERE name = 'urls')",
+			use(lastId), now;
+	/* only listed once its tables exist, so a report can always read it */
+	*_session <<"INSERT INTO partitions SELECT :file, :reportId, "
+			<<"strftime('%s', 'now') WHERE NOT EXISTS "
+			<<"(SELECT 1 FROM partitions WHERE reportId = :id)",
+			use(file[0]), use(reportId), use(reportId), now;
+	_partitionReportId = reportId;
+	_partitionFile = file[0];
+	_logger->information("Logging URLs to " + file[0]);
+}
+
+
+
+void Database::attachPartitions() const {
+	if (!_isPartitioned || _readSession->isTransaction())
+		return;
+
+	std::vector<string> file;
+	*_readSession <<"SELECT file FROM partitions ORDER BY rowid", into(file),
+			now;
+	if (file.size() > DATABASE_MAX_PARTITIONS) {
+		/* the sniffer merges them before this happens; a report that leaves
+		 * some out mustn't be sent */
+		stringstream msg;
+		msg <<"Can't read " <<file.size() <<" partitions of the log, only "
+				<<DATABASE_MAX_PARTITIONS;
+		throw Poco::Data::DataException(msg.str());
+	}
+	if (file == _readPartitions)
+		return;
+
+	detachPartitions();
+	stringstream history, warnings, matches;
+	history <<"CREATE TEMP VIEW history AS SELECT " HISTORY_COLUMNS
+			<<" FROM main.urls AS u JOIN main.hosts AS h ON u.hostId = h.rowid";
+	warnings <<"CREATE TEMP VIEW warnings AS SELECT * FROM main.warnings";
+	matches <<"CREATE TEMP VIEW matches AS SELECT rowid AS rowid, * "
+			<<"FROM main.matches";
+	for (size_t p = 0; p < file.size(); p++) {
+		stringstream schema;
+		schema <<"p" <<p;
+		*_readSession <<"ATTACH DATABASE :file AS " <<schema.str(), use(file[p]),
+				now;
+		_readPartitions.push_back(file[p]);
+		history <<" UNION ALL SELECT " HISTORY_COLUMNS " FROM " <<schema.str()
+				<<".urls AS u JOIN main.hosts AS h ON u.hostId = h.rowid";
+		warnings <<" UNION ALL SELECT * FROM " <<schema.str() <<".warnings";
+		matches <<" UNION ALL SELECT rowid, * FROM " <<schema.str() <<".matches";
+	}
+
+	/* the views shadow the tables of main, and are only in this connection */
+	*_readSession <<"PRAGMA query_only = OFF", now;
+	*_readSession <<history.str(), now;
+	*_readSession <<warnings.str(), now;
+	*_readSession <<matches.str(), now;
+	*_readSession <<"PRAGMA query_only = ON", now;
+}
+
+
+
+void Database::detachPartitions() const {
+	if (!_isPartitioned || _readPartitions.empty())
+		return;
+
+	*_readSession <<"PRAGMA query_only = OFF", now;
+	*_readSession <<"DROP VIEW IF EXISTS temp.history", now;
+	*_readSession <<"DROP VIEW IF EXISTS temp.warnings", now;
+	*_readSession <<"DROP VIEW IF EXISTS temp.matches", now;
+	*_readSession <<"PRAGMA query_only = ON", now;
+	for (size_t p = 0; p < _readPartitions.size(); p++) {
+		stringstream schema;
+		schema <<"p" <<p;
+		*_readSession <<"DETACH DATABASE " <<schema.str(), now;
+	}
+	_readPartitions.clear();
+}
+
+
+
+void Database::convertAutoVacuum() {
+	int mode = 0;
+	try {
+		*_session <<"PRAGMA auto_vacuum", into(mode), now;
+		if (mode == DATABASE_AUTO_VACUUM_INCREMENTAL)
+			return;
+		/* a database from before incremental vacuuming needs one full
+		 * VACUUM to change its mode */
+		_logger->information("Vacuuming the database, this may take a while");
+		*_session <<"PRAGMA auto_vacuum = INCREMENTAL", now;
+		*_session <<"VACUUM", now;
+	}
+	catch (Exception &e) {
+		/* the log works without it, the file just doesn't shrink; it's
+		 * tried again at the next start */
+		_logger->warning("Couldn't vacuum the database: " + e.displayText());
+	}
+}
+
+
+
+void Database::vacuum() {
+	int pages = 0;
+	try {
+		/* does nothing until convertAutoVacuum() has succeeded */
+		*_session <<"PRAGMA freelist_count", into(pages), now;
+		if (pages > 0)
+			*_session <<"PRAGMA incremental_vacuum(" <<DATABASE_VACUUM_PAGES
+					<<")", now;
+	}
+	catch (DBLockedException &e) {
+		/* tried again at the next idle moment */
+	}
+	catch (Exception &e) {
+		_logger->warning(e.displayText());
 	}
 }
 
@@ -544,9 +1354,11 @@ bool Database::isReportTime(int frequency) {
 	const int FINISHED = 30;
 	for (int i = 0; i <= FINISHED; i++) {
 		try {
-			*_session <<"SELECT COUNT() FROM reports "
-					<<"WHERE date > date('now', '-" <<frequency <<" days', 'localtime')"
-					<<" AND completed = 1", into(count), now;
+			/* reports since the start of the local day frequency - 1 days ago */
+			*_readSession <<"SELECT COUNT() FROM reports WHERE time >= CAST(strftime("
+					<<"'%s', 'now', 'localtime', 'start of day', '-" <<frequency - 1
+					<<" days', 'utc') AS INTEGER) AND completed = 1",
+					into(count), now;
 			i = FINISHED;
 		}
 		catch (DBLockedException &e) {
@@ -571,7 +1383,7 @@ int Database::getCount(string from) const {
 	const int FINISHED = 30;
 	for (int i = 0; i <= FINISHED; i++) {
 		try {
-			*_session <<"SELECT COUNT() FROM " <<from, into(count), now;
+			*_readSession <<"SELECT COUNT() FROM " <<from, into(count), now;
 			i = FINISHED;
 		}
 		catch (DBLockedException &e) {
@@ -623,8 +1435,12 @@ std::vector<string> Database::getDistinctHostnames(string where, string orderBy)
 	const int FINISHED = 30;
 	for (int i = 0; i <= FINISHED; i++) {
 		try {
-			*_session <<"SELECT DISTINCT hostname FROM urls WHERE " <<where
-					<<" ORDER BY " <<orderBy, into(hostnames), now;
+			attachPartitions();
+			/* each host is looked up in the index of urls, instead of
+			 * scanning every URL */
+			*_readSession <<"SELECT hostname FROM hosts AS h WHERE EXISTS "
+					<<"(SELECT 1 FROM history WHERE hostId = h.rowid AND ("
+					<<where <<")) ORDER BY " <<orderBy, into(hostnames), now;
 			i = FINISHED;
 		}
 		catch (DBLockedException &e) {
@@ -652,8 +1468,8 @@ Bypasses Database::getBypasses(string where, string orderBy) const {
 	const int FINISHED = 30;
 	for (int i = 0; i <= FINISHED; i++) {
 		try {
-			*_session <<"SELECT type, strftime('%s', date),"
-					<<" strftime('%s', time), details FROM bypasses"
+			*_readSession <<"SELECT type, " LOCAL_DATE_TIME("time")
+					<<", details FROM bypasses"
 					<<where <<" ORDER BY " <<orderBy, into(rows), now;
 			bypasses.setRows(rows);
 			i = FINISHED;
@@ -681,8 +1497,9 @@ History Database::getHistory(string where, string orderBy) const {
 	const int FINISHED = 30;
 	for (int i = 0; i <= FINISHED; i++) {
 		try {
-			*_session <<"SELECT hostname, path, "
-					<<"strftime('%s', date), strftime('%s', time) FROM urls WHERE "
+			attachPartitions();
+			*_readSession <<"SELECT hostname, path, " HISTORY_TIMES("")
+					<<" FROM history WHERE "
 					<<where <<" ORDER BY " <<orderBy, into(rows), now;
 			history.setRows(rows);
 			i = FINISHED;
@@ -704,6 +1521,51 @@ History Database::getHistory(string where, string orderBy) const {
 
 
 
+void Database::getHistory(HistoryHandler& handler, string where,
+		string orderBy) const
+{
+	std::vector<HistoryRow> rows;
+	bool isStarted = false;
+	const int FINISHED = 30;
+	for (int i = 0; i <= FINISHED; i++) {
+		try {
+			attachPartitions();
+			Statement select(*_readSession);
+			select <<"SELECT hostname, path, " HISTORY_TIMES("")
+					<<" FROM history WHERE " <<where <<" ORDER BY " <<orderBy,
+					into(rows), limit(DATABASE_BATCH_ROWS);
+			while (!select.done()) {
+				rows.clear();
+				select.execute();
+				for (std::vector<HistoryRow>::const_iterator r = rows.begin();
+						r != rows.end(); r++)
+				{
+					isStarted = true;
+					handler.handleRow(*r);
+				}
+			}
+			i = FINISHED;
+		}
+		catch (DBLockedException &e) {
+			/* only retried from the start, before any row was handed out */
+			if (i < FINISHED && !isStarted) {
+				_logger->debug("Database locked, will retry to get history");
+				Thread::sleep(200);
+			}
+			else {
+				_logger->warning("Database locked, couldn't get history");
+				i = FINISHED;
+			}
+		}
+		catch (Exception &e) {
+			_logger->warning(e.displayText());
+			i = FINISHED;
+		}
+	}
+}
+
+
+
 Warnings Database::getWarnings(string where, string orderBy, bool whitelist) const {
 	if (where != "")
 		where += " AND ";
@@ -718,13 +1580,14 @@ Warnings Database::getWarnings(string where, string orderBy, bool whitelist) con
 	const int FINISHED = 30;
 	for (int i = 0; i <= FINISHED; i++) {
 		try {
-			*_session <<"SELECT w.urlId, u.hostname, u.path, "
-					<<"strftime('%s', u.date), strftime('%s', u.time), "
+			attachPartitions();
+			*_readSession <<"SELECT w.urlId, u.hostname, u.path, "
+					<<HISTORY_TIMES("u.") <<", "
 					<<"w.boldUrl, w.abbrUrl, w.strength, w.whitelist "
-					<<"FROM warnings AS w JOIN urls AS u ON w.urlId = u.rowid WHERE "
+					<<"FROM warnings AS w JOIN history AS u ON w.urlId = u.id WHERE "
 					<<where <<" ORDER BY " <<orderBy,
 					into(urlId), into(historyRows), into(blacklistMatches), now;
-			getMatches(urlId, blacklistMatches);
+			getMatches(where, urlId, blacklistMatches);
 			warnings.setRows(historyRows, blacklistMatches);
 			i = FINISHED;
 		}
@@ -756,30 +1619,40 @@ Warnings Database::getWhitelist(string where, string orderBy) const {
 
 
 
-void Database::getMatches(std::vector<int> urlId, std::vector<BlacklistMatch> &bm) const {
+void Database::getMatches(const string& where, const std::vector<int>& urlId,
+		std::vector<BlacklistMatch>& bm) const
+{
+	std::unordered_map<int, size_t> warning;
+	std::vector<int> matchUrlId;
 	std::vector<BlacklistKeyword> keywords;
-	for (int i = 0; i < urlId.size(); i++) {
-		const int FINISHED = 30;
-		for (int j = 0; j <= FINISHED; j++) {
-			try {
-				keywords.clear();
-				*_session <<"SELECT keyword, category, strength "
-						<<"FROM matches WHERE urlId = :urlId",
-						into(keywords), use(urlId[i]), now;
-				bm[i].keyword = keywords;
-				j = FINISHED;
-			}
-			catch (DBLockedException &e) {
-				if (j < FINISHED) {
-					_logger->debug("Database locked, will retry to get matches");
-					Thread::sleep(200);
-				}
-				else
-					_logger->warning("Database locked, couldn't get matches");
-			}
-			catch (Exception &e) {
-				_logger->warning(e.displayText());
-			}
+	std::unordered_map<int, size_t>::const_iterator w;
+	KeywordHit hit;
+	hit.index = 0;
+	for (size_t i = 0; i < urlId.size(); i++) {
+		warning[urlId[i]] = i;
+		bm[i].keyword.clear();
+	}
+
+	/* the matches of the same warnings getWarnings() selected, in the order
+	 * they were logged, a batch at a time */
+	Statement select(*_readSession);
+	select <<"SELECT urlId, keyword, category, strength FROM matches "
+			<<"WHERE urlId IN (SELECT w.urlId FROM warnings AS w "
+			<<"JOIN history AS u ON w.urlId = u.id WHERE " <<where <<") "
+			<<"ORDER BY rowid",
+			into(matchUrlId), into(keywords), limit(DATABASE_BATCH_ROWS);
+	while (!select.done()) {
+		matchUrlId.clear();
+		keywords.clear();
+		select.execute();
+		for (size_t k = 0; k < keywords.size(); k++) {
+			w = warning.find(matchUrlId[k]);
+			if (w == warning.end())
+				continue;
+			hit.keyword = KeywordTable::intern(keywords[k].asString);
+			hit.category = KeywordTable::intern(keywords[k].category);
+			hit.strength = keywords[k].strength;
+			bm[w->second].keyword.push_back(hit);
 		}
 	}
 }
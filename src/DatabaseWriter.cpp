@@ -0,0 +1,242 @@
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <DatabaseWriter> is the only thread writing visited URLs to the database
+
+
+#include "DatabaseWriter.h"
+#include "Database.h"
+#include "Poco/LocalDateTime.h"
+#include "Poco/Util/Application.h"
+
+using Poco::Util::Application;
+
+
+
+DatabaseWriter::DatabaseWriter(Database* db, int capacity, bool isBlocking,
+		int flushInterval, int coalesceWindow, int vacuumHour):
+		_coalescer(coalesceWindow),
+		_stopped(false)
+{
+	_db = db;
+	_logger = &Application::instance().logger();
+	_queue.resize(capacity > 0 ? capacity : 1);
+	_head = _count = _highWater = 0;
+	_isBlocking = isBlocking;
+	_flushInterval = (flushInterval > 10 ? flushInterval : 10);
+	_vacuumHour = vacuumHour;
+	_dropped = _written = 0;
+	_isStopping = false;
+}
+
+
+
+void DatabaseWriter::log(const HttpRequestView& request, Poco::Int64 time,
+		bool isMatch, const BlacklistMatch& match)
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	while (_count == _queue.size() && !_isStopping) {
+		if (!_isBlocking) {
+			_dropped++;
+			return;
+		}
+		_notFull.wait(_mutex);
+	}
+	if (_isStopping)
+		return;
+
+	/* the slot keeps its string capacity from earlier events */
+	LogEvent &event = _queue[(_head + _count) % _queue.size()];
+	event.hostname.assign(request.host.data(), request.host.length());
+	event.path.assign(request.target.data(), request.target.length());
+	event.time = time;
+	event.isMatch = isMatch;
+	if (isMatch)
+		event.match = match;
+	_count++;
+	if (_count > _highWater)
+		_highWater = _count;
+	_notEmpty.signal();
+}
+
+
+
+void DatabaseWriter::run() {
+	HttpRequestView request;
+	while (!isStopping()) {
+		/* nothing thrown may end the thread, or the queue is never emptied
+		 * and stop() waits in vain */
+		try {
+			bool isIdle = !pop(_flushInterval);
+			if (!isIdle)
+				write(request);
+			release(request, Timestamp().epochTime(), false);
+			_db->flushUrls();
+			if (isIdle && _vacuumHour >= 0
+					&& Poco::LocalDateTime().hour() == _vacuumHour)
+				_db->vacuum();
+
+			if (_logger->debug()
+					&& _lastStats.isElapsed(60 * Timestamp::resolution()))
+				logStats();
+		}
+		catch (Poco::Exception &err) {
+			logError(err.displayText());
+		}
+		catch (std::exception &err) {
+			logError(err.what());
+		}
+	}
+
+	/* log() takes no more events, so this empties the queue */
+	while (pop(0)) {
+		try {
+			write(request);
+		}
+		catch (Poco::Exception &err) {
+			logError(err.displayText());
+		}
+		catch (std::exception &err) {
+			logError(err.what());
+		}
+	}
+	try {
+		release(request, Timestamp().epochTime(), true);
+		/* whatever the batch size and interval, nothing may be left behind */
+		_db->flushUrls(true);
+		_db->logSessionStop();
+	}
+	catch (Poco::Exception &err) {
+		logError(err.displayText());
+	}
+	catch (std::exception &err) {
+		logError(err.what());
+	}
+	_stopped.set();
+}
+
+
+
+bool DatabaseWriter::stop() {
+	{
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		_isStopping = true;
+		_notEmpty.signal();
+		_notFull.broadcast();
+	}
+	return _stopped.tryWait(DATABASE_WRITER_STOP_TIMEOUT);
+}
+
+
+
+void DatabaseWriter::write(HttpRequestView& request) {
+	if (!_event.isMatch
+			&& _coalescer.add(_event.hostname, _event.path, _event.time))
+		return;
+	request.host = _event.hostname;
+	request.target = _event.path;
+	_db->logUrl(request, _event.time);
+	if (_event.isMatch)
+		_db->logWarning(_event.match);
+}
+
+
+
+void DatabaseWriter::release(HttpRequestView& request, Poco::Int64 now,
+		bool all)
+{
+	while (_coalescer.pop(_url, now, all)) {
+		request.host = _url.hostname;
+		request.target = _url.path;
+		_db->logUrl(request, _url.time, _url.hits, _url.lastSeen);
+	}
+}
+
+
+
+bool DatabaseWriter::pop(long timeout) {
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	if (_count == 0 && !_notEmpty.tryWait(_mutex, timeout))
+		return false;
+	if (_count == 0)
+		return false;
+
+	/* swap rather than copy, so no strings are allocated on either side */
+	LogEvent &event = _queue[_head];
+	_event.hostname.swap(event.hostname);
+	_event.path.swap(event.path);
+	_event.time = event.time;
+	_event.isMatch = event.isMatch;
+	if (event.isMatch)
+		std::swap(_event.match, event.match);
+	_head = (_head + 1) % _queue.size();
+	_count--;
+	_written++;
+	_notFull.signal();
+	return true;
+}
+
+
+
+size_t DatabaseWriter::getDepth() const {
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	return _count;
+}
+
+
+
+size_t DatabaseWriter::getHighWater() const {
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	return _highWater;
+}
+
+
+
+Poco::UInt64 DatabaseWriter::getDropped() const {
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	return _dropped;
+}
+
+
+
+Poco::UInt64 DatabaseWriter::getWritten() const {
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	return _written;
+}
+
+
+
+bool DatabaseWriter::isStopping() const {
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	return _isStopping;
+}
+
+
+
+void DatabaseWriter::logError(const string& message) {
+	_logger->warning("Database writer: " + message);
+}
+
+
+
+void DatabaseWriter::logStats() {
+	stringstream msg;
+	msg <<"Database writer: " <<getWritten() <<" written, queue "
+			<<getDepth() <<"/" <<_queue.size() <<" (high " <<getHighWater()
+			<<", dropped " <<getDropped() <<"), " <<_coalescer.size()
+			<<" URLs held";
+	_logger->debug(msg.str());
+	_lastStats.update();
+}
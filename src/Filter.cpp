@@ -17,27 +17,73 @@
 
 #include "Filter.h"
 
+#include <cstring>
+#include <cctype>
+
+/* the classes of the bytes in a decoded URL */
+#define CHAR_TOKEN_DELIMITER 1
+#define CHAR_WORD_DELIMITER 2
+
+static struct CharClasses
+{
+	unsigned char of[256];
+
+	CharClasses()
+	{
+		memset(of, 0, sizeof(of));
+		for (const char *c = "/#%?&;"; *c; c++)
+			of[(unsigned char)*c] |= CHAR_TOKEN_DELIMITER;
+		for (const char *c = " \t\n\v\f\r-_+\"'."; *c; c++)
+			of[(unsigned char)*c] |= CHAR_WORD_DELIMITER;
+	}
+} charClasses;
+
+
 
 Filter::Filter() {
-	setRegexps();
+	_isCombined = false;
+	buildLiteralMatcher();
+	buildMultiMatcher();
+	buildExtensionTable();
+	buildKeywordTable();
 }
 
 
 
 Filter::Filter(string blacklistFile) {
-	setRegexps();
+	_isCombined = false;
 	loadBlacklist(blacklistFile);
 }
 
 
 
 Filter::Filter(Options *options, Database *db) {
-	setRegexps();
+	setOptions(options);
 	loadBlacklist(options, db);
 }
 
 
 
+Filter::Filter(Options *options) {
+	setOptions(options);
+	readBlacklist(options);
+	buildLiteralMatcher();
+	buildMultiMatcher();
+	buildExtensionTable();
+	buildKeywordTable();
+}
+
+
+
+void Filter::setOptions(Options *options) {
+	_isCombined = (options->getFilterEngine() == "dfa");
+	_verdicts.setCapacity(options->getVerdictCacheSize(),
+			options->getCacheShards());
+	_hosts.setCapacity(options->getHostCacheSize(), options->getCacheShards());
+}
+
+
+
 void Filter::loadBlacklist(string path) {
 	try {
 		AutoPtr<MyXml> xmlBlacklist (new MyXml(path));
@@ -47,18 +93,20 @@ void Filter::loadBlacklist(string path) {
 	catch (Exception &err) {
 		Application::instance().logger().information("Couldn't load blacklist");
 		//download new
-	}
+	}
+	buildLiteralMatcher();
+	buildMultiMatcher();
+	buildExtensionTable();
+	buildKeywordTable();
 
 }
 
 
 
-void Filter::loadBlacklist(Options *options, Database *db) {
+void Filter::loadBlacklist(Options *options, Database *db) {
 	for (int moreTries = 3; moreTries > 0; moreTries--) {
 		try {
-			AutoPtr<MyXml> xmlBlacklist (new MyXml(options->getBlacklistFile()));
-			_blacklist   = xmlBlacklist->getBlacklist();
-			_extensions  = xmlBlacklist->getExtensions();
+			readBlacklist(options);
 			moreTries = 0;
 		}
 		catch (Poco::FileNotFoundException &err) {
@@ -78,107 +126,328 @@ void Filter::loadBlacklist(Options *options, Database *db) {
 			Request::downloadBlacklist(options);
 		}
 	}
+	buildLiteralMatcher();
+	buildMultiMatcher();
+	buildExtensionTable();
+	buildKeywordTable();
+}
+
+
+
+void Filter::readBlacklist(Options *options) {
+	Timestamp started;
+	bool isSnapshot = options->getBlacklistSnapshot()
+			&& BlacklistSnapshot::read(options->getBlacklistFile(),
+			_blacklist, _extensions);
+	if (!isSnapshot) {
+		AutoPtr<MyXml> xmlBlacklist (new MyXml(options->getBlacklistFile()));
+		_blacklist   = xmlBlacklist->getBlacklist();
+		_extensions  = xmlBlacklist->getExtensions();
+		if (options->getBlacklistSnapshot())
+			BlacklistSnapshot::write(options->getBlacklistFile(),
+					_blacklist, _extensions);
+	}
+
+	stringstream msg;
+	msg <<"Blacklist loaded from " <<(isSnapshot ? "snapshot" : "XML") <<" in "
+			<<started.elapsed() / 1000 <<" ms";
+	Application::instance().logger().debug(msg.str());
+}
+
+
+
+void Filter::buildLiteralMatcher() {
+	int unfiltered = 0;
+	/* every verdict was given by the previous blacklist */
+	_verdicts.clear();
+	_hosts.clear();
+	_literals = LiteralMatcher();
+	_keywordLiterals.clear();
+	_urlsScanned = _keywordsConfirmed = _keywordsSkipped = 0;
+
+	for (Blacklist::iterator c = _blacklist.begin(); c != _blacklist.end(); c++) {
+		for (vector<BlacklistKeyword>::iterator k = c->keyword.begin();
+				k != c->keyword.end(); k++)
+		{
+			_keywordLiterals.push_back(vector<int>());
+			for (vector<string>::iterator l = k->literal.begin();
+					l != k->literal.end(); l++)
+			{
+				if (!l->empty())
+					_keywordLiterals.back().push_back(_literals.add(*l));
+			}
+			if (_keywordLiterals.back().empty())
+				unfiltered++;
+		}
+	}
+	_literals.compile();
+
+	stringstream msg;
+	msg <<"Literal prefilter: " <<_literals.getLiteralCount() <<" literals, "
+			<<_literals.getStateCount() <<" states, " <<unfiltered <<" of "
+			<<_keywordLiterals.size() <<" keywords always checked";
+	Application::instance().logger().debug(msg.str());
+}
+
+
+
+void Filter::buildMultiMatcher() {
+	size_t regexps = 0;
+	_multiMatcher = MultiMatcher();
+	_keywordPatterns.clear();
+
+	for (Blacklist::iterator c = _blacklist.begin(); c != _blacklist.end(); c++) {
+		for (vector<BlacklistKeyword>::iterator k = c->keyword.begin();
+				k != c->keyword.end(); k++)
+		{
+			_keywordPatterns.push_back(vector<int>());
+			for (vector<string>::iterator p = k->pattern.begin();
+					p != k->pattern.end(); p++)
+			{
+				_keywordPatterns.back().push_back(
+						_isCombined ? _multiMatcher.add(*p) : -1);
+				regexps++;
+			}
+		}
+	}
+	if (!_isCombined)
+		return;
+	_multiMatcher.compile();
+
+	stringstream msg;
+	msg <<"Combined DFA: " <<_multiMatcher.getPatternCount() <<" of "
+			<<regexps <<" regular expressions, "
+			<<_multiMatcher.getNfaStateCount() <<" NFA states; the rest are run"
+			<<" by PCRE";
+	Application::instance().logger().debug(msg.str());
+}
+
+
+
+const LruCache<FilterVerdict>& Filter::getVerdictCache() const {
+	return _verdicts;
+}
+
+
+
+const LruCache<HostHistory>& Filter::getHostCache() const {
+	return _hosts;
+}
+
+
+
+Poco::UInt64 Filter::getUrlsScanned() const {
+	return _urlsScanned.load(std::memory_order_relaxed);
+}
+
+
+
+Poco::UInt64 Filter::getKeywordsConfirmed() const {
+	return _keywordsConfirmed.load(std::memory_order_relaxed);
+}
+
+
+
+Poco::UInt64 Filter::getKeywordsSkipped() const {
+	return _keywordsSkipped.load(std::memory_order_relaxed);
 }
 
 
 
-bool Filter::isMatch(HTTPRequest& request, BlacklistMatch& blacklistMatch) {
-	return isUrlMatch(request, blacklistMatch)
+bool Filter::isMatch(const HttpRequestView& request,
+		BlacklistMatch& blacklistMatch)
+{
+	static thread_local string url;
+	static thread_local FilterVerdict verdict;
+	request.getUrl(url);
+
+	if (_verdicts.get(url, verdict)) {
+		if (verdict.isMatch)
+			blacklistMatch = verdict.match;
+		else
+			blacklistMatch.keyword.clear();
+		return verdict.isMatch;
+	}
+	if (isHostClean(request)) {
+		blacklistMatch.keyword.clear();
+		return false;
+	}
+
+	verdict.isMatch = isUrlMatch(request, blacklistMatch)
 			&& isTokenMatch(request, blacklistMatch);
+	updateHost(request, !blacklistMatch.keyword.empty());
+	if (verdict.isMatch)
+		verdict.match = blacklistMatch;
+	else
+		verdict.match.keyword.clear();
+	_verdicts.put(url, verdict);
+	return verdict.isMatch;
+}
+
+
+
+bool Filter::isHostClean(const HttpRequestView& request) {
+	static thread_local string host;
+	HostHistory history;
+	if (_hosts.capacity() == 0)
+		return false;
+	host.assign(request.host.data(), request.host.length());
+	if (!_hosts.get(host, history) || history.hasHit
+			|| history.clean < HOST_CACHE_MIN_CLEAN)
+		return false;
+	if (++history.skipped % HOST_CACHE_RECHECK == 0)
+		return false;
+	_hosts.put(host, history);
+	return true;
+}
+
+
+
+void Filter::updateHost(const HttpRequestView& request, bool hasHit) {
+	static thread_local string host;
+	HostHistory history;
+	if (_hosts.capacity() == 0)
+		return;
+	host.assign(request.host.data(), request.host.length());
+	if (!_hosts.get(host, history)) {
+		history.clean = history.skipped = 0;
+		history.hasHit = false;
+	}
+	if (hasHit)
+		history.hasHit = true;
+	else
+		history.clean++;
+	_hosts.put(host, history);
 }
 
 
 
-bool Filter::isUrlMatch(HTTPRequest& request, BlacklistMatch& blacklistMatch) {
+bool Filter::isUrlMatch(const HttpRequestView& request,
+		BlacklistMatch& blacklistMatch)
+{
 	blacklistMatch.keyword.clear();
 	blacklistMatch.whitelist = false;
-	string url = request.getHost() + request.getURI(),
-		boldUrl = url;
+	string url;
+	request.getUrl(url);
 	bool isSubMatch,
 		isMatch = false;
 	int strength = 0;
+	size_t keyword = 0,
+		confirmed = 0,
+		r;
+	int id;
+	KeywordHit hit;
 	RegularExpression::Match m;
 
+	/* the literals and patterns found in this URL, and the DFA states
+	 * built so far; one of each per FilterWorker */
+	static thread_local vector<char> found,
+		matched;
+	static thread_local MultiMatcher::Cache cache;
+	_literals.scan(url.data(), url.length(), found);
+	if (_isCombined)
+		_multiMatcher.scan(url.data(), url.length(), cache, matched);
+
 	for (Blacklist::iterator c = _blacklist.begin(); c != _blacklist.end(); c++) {
 		for (vector<BlacklistKeyword>::iterator k = c->keyword.begin();
 				k != c->keyword.end(); k++)
 		{
+			const vector<int> &patterns = _keywordPatterns[keyword];
+			if (!isCandidate(_keywordLiterals[keyword++], found))
+				continue;
+			confirmed++;
 			isSubMatch = true;
-			for (vector< SharedPtr<RegularExpression> >::iterator
-					r = k->re.begin(); r != k->re.end(); r++)
-			{
-				if (!(**r).match(url, m)) {
+			for (r = 0; r < k->re.size(); r++) {
+				id = patterns[r];
+				if (id >= 0 ? !matched[id] : !k->re[r]->match(url, m)) {
 					isSubMatch = false;
 					break;
 				}
 			}
 			if (isSubMatch) {
-				for (vector< SharedPtr<RegularExpression> >::iterator
-						r = k->re.begin(); r != k->re.end(); r++)
-				{
-					(**r).subst(boldUrl, "<b>$0</b>", RegularExpression::RE_GLOBAL);
-				}
-				blacklistMatch.keyword.push_back(*k);
-				blacklistMatch.keyword.back().category = c->name;
+				hit.keyword = k->id;
+				hit.category = k->categoryId;
+				hit.strength = k->strength;
+				hit.index = keyword - 1;
+				blacklistMatch.keyword.push_back(hit);
 				strength += k->strength;
-				if (c->name == "Whitelist")
+				if (k->categoryId == _whitelistId)
 					blacklistMatch.whitelist = true;
 				else
 					isMatch = true;
 			}
 		}
 	}
-	blacklistMatch.boldUrl = (isMatch ? boldUrl : "");
-	blacklistMatch.abbrUrl = (isMatch ? abbrUrl(boldUrl) : "");
+	_urlsScanned.fetch_add(1, std::memory_order_relaxed);
+	_keywordsConfirmed.fetch_add(confirmed, std::memory_order_relaxed);
+	_keywordsSkipped.fetch_add(keyword - confirmed, std::memory_order_relaxed);
+
+	/* the bold and abbreviated URLs are only kept for matches, so they're
+	 * only built for them, into the buffers of blacklistMatch */
+	if (isMatch) {
+		blacklistMatch.boldUrl = url;
+		for (size_t i = 0; i < blacklistMatch.keyword.size(); i++) {
+			const BlacklistKeyword *k = _keywords[blacklistMatch.keyword[i].index];
+			for (vector< SharedPtr<RegularExpression> >::const_iterator
+					r = k->re.begin(); r != k->re.end(); r++)
+			{
+				highlight(**r, blacklistMatch.boldUrl);
+			}
+		}
+		abbreviate(blacklistMatch.boldUrl, blacklistMatch.abbrUrl);
+	}
+	else {
+		blacklistMatch.boldUrl.clear();
+		blacklistMatch.abbrUrl.clear();
+	}
 	blacklistMatch.strength = (isMatch ? strength : 0);
 	return isMatch;
 }
 
 
 
-bool Filter::isTokenMatch(HTTPRequest& request, BlacklistMatch& blacklistMatch) {
+bool Filter::isTokenMatch(const HttpRequestView& request,
+		BlacklistMatch& blacklistMatch)
+{
 	bool isSubMatch,
 		isMatch = false;
-	RegularExpression::Match m, n;
+	RegularExpression::Match n;
 	float strength = 0,
 		strengthFactor = 0,
 		wordFactor = 0.5;
 	int tokenMatches = 0;
-	unsigned int o = 0;
-	string url = request.getHost() + request.getURI(),
+	size_t o = 0;
+	string_view view;
+	static thread_local string url,
 		token,
-		decodedUrl = "";
-	try {
-		Poco::URI::decode(url, decodedUrl);
-	}
-	catch (Poco::Exception &exc) {
-		decodedUrl = url;
-	}
-	while (o < decodedUrl.length()) {
-		_splitToken->match(decodedUrl, o, m);
-		if (m.offset == string::npos)
-			m.offset = decodedUrl.length();
-		token = decodedUrl.substr(o, m.offset-o);
-		if (token.length() > 2) {
+		decodedUrl;
+	request.getUrl(url);
+	decodedUrl.clear();
+	try {
+		Poco::URI::decode(url, decodedUrl);
+	}
+	catch (Poco::Exception &exc) {
+		decodedUrl = url;
+	}
+	while (nextToken(decodedUrl, o, view)) {
+		if (view.length() > 2) {
+			token.assign(view.data(), view.length());
 			tokenMatches = 0;
-			for (vector<BlacklistKeyword>::iterator
-					k = blacklistMatch.keyword.begin();
-					k != blacklistMatch.keyword.end(); k++)
-			{
+			for (size_t i = 0; i < blacklistMatch.keyword.size(); i++) {
+				const BlacklistKeyword *k =
+						_keywords[blacklistMatch.keyword[i].index];
 				isSubMatch = true;
 				strengthFactor = 0;
-				for (vector< SharedPtr<RegularExpression> >::iterator
+				for (vector< SharedPtr<RegularExpression> >::const_iterator
 						r = k->re.begin(); r != k->re.end(); r++)
 				{
 					if ((**r).match(token, n)) {
 						while (n.offset != string::npos) {
 							if (n.offset == 0
-									|| _wordDelimiter->
-									match(token.substr(n.offset-1, 1)))
-								wordFactor += 0.5;
+									|| isWordDelimiter(token[n.offset - 1]))
+								wordFactor += 0.5;
 							if (n.offset + n.length == token.length()
-									|| _wordDelimiter->match(
-									token.substr(n.offset + n.length, 1)))
+									|| isWordDelimiter(token[n.offset + n.length]))
 								wordFactor += 0.5;
 							strengthFactor += (float)n.length/token.length()
 									* wordFactor;
@@ -198,10 +467,9 @@ bool Filter::isTokenMatch(HTTPRequest& request, BlacklistMatch& blacklistMatch)
 					strength += strengthFactor * k->strength;
 				}
 
-			}
-		}
-		o = m.offset + m.length;
-	}
+			}
+		}
+	}
 	strength *= getExtensionFactor(url);
 
 	if (isMatch)
@@ -211,39 +479,264 @@ bool Filter::isTokenMatch(HTTPRequest& request, BlacklistMatch& blacklistMatch)
 
 
 
-string Filter::abbrUrl(string boldUrl)
+bool Filter::isCandidate(const vector<int>& literals,
+		const vector<char>& found)
 {
-	RegularExpression a ("(^[^\\/]*\\/)([^<>]*)([^<>]{25}<b>)", 0, false),
-		b ("(<\\/b>[^<>]{25})([^<>]*)([^<>]{25}<b>)", 0, false),
-		c ("(<\\/b>[^<>]{25})([^<>]*$)", 0, false);
-	a.subst(boldUrl, "$1 ... $3", RegularExpression::RE_GLOBAL);
-	b.subst(boldUrl, "$1 ... $3", RegularExpression::RE_GLOBAL);
-	c.subst(boldUrl, "$1 ...", RegularExpression::RE_GLOBAL);
-	return boldUrl;
+	for (vector<int>::const_iterator l = literals.begin(); l != literals.end(); l++) {
+		if (!found[*l])
+			return false;
+	}
+	return true;
 }
-
-
-
-void Filter::setRegexps() {
-	_splitToken =
-			new RegularExpression("((\\?|\\&|;).*?\\=)|\\/|(\\%2F)|#", 0, true);
-	_wordDelimiter = new RegularExpression("[\\s-_+\"']||\\.", 0, true);
-	_splitExtension = new RegularExpression("/?(?:[^/?#]+/)+(?:[^?#]+\\.)"
-			"([a-zA-Z0-9]{1,4})(?:$|\\?|#).*", 0, true);
+
+
+
+bool Filter::nextToken(string_view text, size_t& offset, string_view& token) {
+	size_t start = offset,
+		i,
+		j;
+	if (start >= text.length())
+		return false;
+
+	for (i = start; i < text.length(); i++) {
+		if (!(charClasses.of[(unsigned char)text[i]] & CHAR_TOKEN_DELIMITER))
+			continue;
+		switch (text[i]) {
+			case '/':
+			case '#':
+				token = text.substr(start, i - start);
+				offset = i + 1;
+				return true;
+			case '%':
+				if (text.compare(i, 3, "%2F") != 0)
+					continue;
+				token = text.substr(start, i - start);
+				offset = i + 3;
+				return true;
+			default:
+				/* "?", "&" or ";" only ends a token if there's a "=" before
+				 * the end of the line */
+				for (j = i + 1; j < text.length()
+						&& text[j] != '=' && text[j] != '\n'; j++);
+				if (j == text.length() || text[j] != '=')
+					continue;
+				token = text.substr(start, i - start);
+				offset = j + 1;
+				return true;
+		}
+	}
+	token = text.substr(start);
+	offset = text.length();
+	return true;
+}
+
+
+
+bool Filter::isWordDelimiter(char c) {
+	return (charClasses.of[(unsigned char)c] & CHAR_WORD_DELIMITER) != 0;
+}
+
+
+
+void Filter::highlight(const RegularExpression& re, string& text) {
+	RegularExpression::Match m;
+	size_t offset = 0;
+
+	/* like subst(), search on from the end of the last tag, in the text as
+	 * it is by then */
+	while (offset < text.length() && re.match(text, offset, m) > 0) {
+		if (m.length == 0) {
+			/* subst() would never return from an empty match */
+			offset = m.offset + 1;
+			continue;
+		}
+		text.insert(m.offset + m.length, "</b>");
+		text.insert(m.offset, "<b>");
+		offset = m.offset + m.length + 7;
+	}
+}
+
+
+
+void Filter::abbreviate(const string& boldUrl, string& abbrUrl) {
+	size_t from = 0,
+		run,
+		end,
+		i;
+	abbrUrl.clear();
+
+	/* This does what these three substitutions, in this order, used to do:
+	 *   (^[^\/]*\/)([^<>]*)([^<>]{25}<b>)          -> $1 ... $3
+	 *   (<\/b>[^<>]{25})([^<>]*)([^<>]{25}<b>)    -> $1 ... $3 (global)
+	 *   (<\/b>[^<>]{25})([^<>]*$)                 -> $1 ...
+	 * Each one only touches a stretch without '<' or '>' that none of the
+	 * others touches, so they can all be done in a single pass. */
+	run = boldUrl.find('/');
+	if (run != string::npos) {
+		run++;
+		end = boldUrl.find_first_of("<>", run);
+		if (end != string::npos && boldUrl.compare(end, 3, "<b>") == 0
+				&& end - run >= 25)
+		{
+			abbrUrl.append(boldUrl, 0, run).append(" ... ");
+			from = end - 25;
+		}
+	}
+	for (i = boldUrl.find("</b>"); i != string::npos;
+			i = boldUrl.find("</b>", end))
+	{
+		run = i + 4;
+		end = boldUrl.find_first_of("<>", run);
+		if (end == string::npos) {
+			if (boldUrl.length() - run >= 25) {
+				abbrUrl.append(boldUrl, from, run + 25 - from).append(" ...");
+				from = boldUrl.length();
+			}
+			break;
+		}
+		if (boldUrl.compare(end, 3, "<b>") == 0 && end - run >= 50) {
+			abbrUrl.append(boldUrl, from, run + 25 - from).append(" ... ");
+			from = end - 25;
+		}
+	}
+	abbrUrl.append(boldUrl, from, string::npos);
 }
 
 
 
-float Filter::getExtensionFactor(string url) {
-	if (_splitExtension->match(url)) {
-		string ext = url;
-		_splitExtension->subst(ext, "$1");
-		for (Extensions::iterator it = _extensions.begin();
-				it != _extensions.end(); it++)
-		{
-			if ((*it).re->match(ext))
-				return (float)it->strength/100;
-		}
-	}
-	return 1;
+void Filter::buildKeywordTable() {
+	_keywords.clear();
+	_whitelistId = KeywordTable::intern("Whitelist");
+	for (Blacklist::iterator c = _blacklist.begin(); c != _blacklist.end(); c++) {
+		for (vector<BlacklistKeyword>::iterator k = c->keyword.begin();
+				k != c->keyword.end(); k++)
+		{
+			k->id = KeywordTable::intern(k->asString);
+			k->categoryId = KeywordTable::intern(c->name);
+			_keywords.push_back(&*k);
+		}
+	}
+}
+
+
+
+void Filter::buildExtensionTable() {
+	size_t size = 2,
+		slot;
+	Poco::UInt32 key;
+	bool isLiteral;
+
+	while (size < 2 * _extensions.size())
+		size <<= 1;
+	_extensionKeys.assign(size, 0);
+	_extensionIds.assign(size, -1);
+	_extensionPatterns.clear();
+
+	for (size_t i = 0; i < _extensions.size(); i++) {
+		const string &pattern = _extensions[i].pattern;
+		isLiteral = (!pattern.empty() && pattern.length() <= EXTENSION_MAX_LEN);
+		for (size_t c = 0; c < pattern.length() && isLiteral; c++)
+			isLiteral = isalnum((unsigned char)pattern[c]);
+		if (!isLiteral) {
+			_extensionPatterns.push_back(i);
+			continue;
+		}
+
+		key = packExtension(pattern.data(), pattern.length());
+		slot = (key * 2654435761u >> 8) & (size - 1);
+		while (_extensionKeys[slot] != 0 && _extensionKeys[slot] != key)
+			slot = (slot + 1) & (size - 1);
+		/* the first extension listed wins, as when they were all tried in
+		 * turn */
+		if (_extensionKeys[slot] == 0) {
+			_extensionKeys[slot] = key;
+			_extensionIds[slot] = i;
+		}
+	}
+}
+
+
+
+bool Filter::findExtension(const string& url, size_t& start, size_t& length) {
+	size_t i = 0,
+		slash,
+		end,
+		dot;
+
+	/* "/?(?:[^/?#]+/)+" needs at least one non-empty directory */
+	if (i < url.length() && url[i] == '/')
+		i++;
+	slash = url.find_first_of("/?#", i);
+	if (slash == string::npos || slash == i || url[slash] != '/')
+		return false;
+
+	/* "(?:$|\?|#).*" ends the path, and the whole line must match */
+	end = url.find_first_of("?#", slash + 1);
+	if (end == string::npos)
+		end = url.length();
+	else if (url.find('\n', end) != string::npos)
+		return false;
+
+	/* "(?:[^?#]+\.)([a-zA-Z0-9]{1,4})" can only end at the last dot, and
+	 * needs something between the directory and the dot */
+	dot = url.rfind('.', end - 1);
+	if (dot == string::npos || dot < slash + 2)
+		return false;
+	start = dot + 1;
+	length = end - start;
+	if (length < 1 || length > EXTENSION_MAX_LEN)
+		return false;
+	for (i = start; i < end; i++) {
+		if (!((url[i] >= 'a' && url[i] <= 'z') || (url[i] >= 'A' && url[i] <= 'Z')
+				|| (url[i] >= '0' && url[i] <= '9')))
+			return false;
+	}
+	return true;
+}
+
+
+
+Poco::UInt32 Filter::packExtension(const char* text, size_t length) {
+	Poco::UInt32 key = 0;
+	for (size_t i = 0; i < length && i < EXTENSION_MAX_LEN; i++)
+		key = (key << 8) | (unsigned char)tolower((unsigned char)text[i]);
+	return key;
+}
+
+
+
+float Filter::getExtensionFactor(const string& url) {
+	size_t start,
+		length,
+		slot;
+	Poco::UInt32 key;
+	int id = -1;
+	static thread_local string ext;
+
+	if (!findExtension(url, start, length))
+		return 1;
+
+	key = packExtension(url.data() + start, length);
+	slot = (key * 2654435761u >> 8) & (_extensionKeys.size() - 1);
+	while (_extensionKeys[slot] != 0) {
+		if (_extensionKeys[slot] == key) {
+			id = _extensionIds[slot];
+			break;
+		}
+		slot = (slot + 1) & (_extensionKeys.size() - 1);
+	}
+
+	/* a pattern that isn't literal still wins if it's listed first */
+	if (!_extensionPatterns.empty() && (id < 0 || _extensionPatterns[0] < id)) {
+		ext.assign(url, start, length);
+		for (vector<int>::iterator p = _extensionPatterns.begin();
+				p != _extensionPatterns.end() && (id < 0 || *p < id); p++)
+		{
+			if (_extensions[*p].re->match(ext)) {
+				id = *p;
+				break;
+			}
+		}
+	}
+	return (id < 0 ? 1 : (float)_extensions[id].strength/100);
 }
@@ -0,0 +1,123 @@
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <FilterLoader> builds a new Filter whenever the blacklist changes
+
+
+#include "FilterLoader.h"
+#include "Sniffer.h"
+
+#include <sstream>
+
+#include "Poco/Thread.h"
+#include "Poco/Util/Application.h"
+
+using Poco::Util::Application;
+
+
+
+std::atomic<bool> FilterLoader::_isReloadRequested(false);
+
+
+
+FilterLoader::FilterLoader(Options* options, int checkInterval) {
+	_options = options;
+	_logger = &Application::instance().logger();
+	_checkInterval = (Timestamp::TimeDiff)checkInterval * Timestamp::resolution();
+	_size = 0;
+	_isChanging = false;
+	_isStopping = false;
+}
+
+
+
+void FilterLoader::run() {
+	remember();
+	while (!_isStopping) {
+		Poco::Thread::sleep(1000);
+		if (_isReloadRequested.exchange(false))
+			reload();
+		else if (_checkInterval > 0
+				&& (_isChanging || _lastCheck.isElapsed(_checkInterval)))
+		{
+			_lastCheck.update();
+			if (hasChanged())
+				reload();
+		}
+	}
+}
+
+
+
+void FilterLoader::stop() {
+	_isStopping = true;
+}
+
+
+
+void FilterLoader::requestReload() {
+	_isReloadRequested = true;
+}
+
+
+
+bool FilterLoader::hasChanged() {
+	Poco::File::FileSize size = _size;
+	Timestamp modified = _modified;
+	remember();
+	if (_size != size || _modified != modified) {
+		/* check again in a second, it may not be completely written yet */
+		_isChanging = true;
+		return false;
+	}
+	if (_isChanging) {
+		_isChanging = false;
+		return true;
+	}
+	return false;
+}
+
+
+
+void FilterLoader::remember() {
+	try {
+		Poco::File file(_options->getBlacklistFile());
+		_size = file.getSize();
+		_modified = file.getLastModified();
+	}
+	catch (Poco::Exception &err) {
+		_size = 0;
+		_modified = 0;
+	}
+}
+
+
+
+void FilterLoader::reload() {
+	Timestamp started;
+	try {
+		SharedPtr<Filter> filter = new Filter(_options);
+		Sniffer::publishFilter(filter);
+		stringstream msg;
+		msg <<"Blacklist reloaded in " <<started.elapsed() / 1000 <<" ms";
+		_logger->information(msg.str());
+	}
+	catch (Poco::Exception &err) {
+		_logger->warning("Couldn't reload blacklist, keeping the current one: "
+				+ err.displayText());
+	}
+	remember();
+	_isChanging = false;
+}
@@ -0,0 +1,164 @@
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <FilterWorker> drains captured requests, filters them and logs them
+
+
+#include "FilterWorker.h"
+
+
+
+FilterWorker::FilterWorker(int id) {
+	_id = id;
+	_logStream = &Sniffer::getLogStream();
+	_filterGeneration = Sniffer::getFilterGeneration();
+	_filter = Sniffer::getFilter();
+	_isDebugging = Application::instance().config().getBool("debug", false);
+	_processed = 0;
+	_isStopping = false;
+}
+
+
+
+void FilterWorker::addRing(UrlRing* ring) {
+	_rings.push_back(ring);
+}
+
+
+
+void FilterWorker::run() {
+	const int SPINS_BEFORE_SLEEP = 64;
+	int idle = 0;
+
+	while (!_isStopping) {
+		if (drain())
+			idle = 0;
+		else if (++idle > SPINS_BEFORE_SLEEP)
+			Poco::Thread::sleep(1);
+		else
+			Poco::Thread::yield();
+
+		if (_isDebugging && _lastStats.isElapsed(60 * Timestamp::resolution()))
+			logStats();
+	}
+
+	/* whatever was captured before stop() is still filtered and logged */
+	drain();
+}
+
+
+
+void FilterWorker::stop() {
+	_isStopping = true;
+}
+
+
+
+bool FilterWorker::drain() {
+	bool gotRecord = false;
+	UrlRecord *record;
+	for (vector<UrlRing*>::iterator it = _rings.begin();
+			it != _rings.end(); it++)
+	{
+		while ((record = (*it)->front()) != 0) {
+			process(*record);
+			delete record->longUri;
+			(*it)->pop();
+			gotRecord = true;
+		}
+	}
+	return gotRecord;
+}
+
+
+
+void FilterWorker::process(const UrlRecord& record) {
+	bool isMatch;
+	try {
+		/* a new Filter is only picked up between two URLs, so every URL is
+		 * filtered with a single blacklist */
+		if (Sniffer::getFilterGeneration() != _filterGeneration) {
+			_filterGeneration = Sniffer::getFilterGeneration();
+			_filter = Sniffer::getFilter();
+		}
+		_request.host = string_view(record.host, record.hostLength);
+		_request.target = record.getUri();
+
+		isMatch = _filter->isMatch(_request, _match);
+		Sniffer::logRequest(_request, record.time, isMatch, _match);
+		_processed++;
+
+		if (_isDebugging)
+			*_logStream <<isMatch <<endl;
+	}
+	catch (Poco::Exception &err) {
+		if (_isDebugging)
+			*_logStream <<'-' <<endl;
+	}
+}
+
+
+
+size_t FilterWorker::getOccupancy() const {
+	size_t occupancy = 0;
+	for (vector<UrlRing*>::const_iterator it = _rings.begin();
+			it != _rings.end(); it++)
+	{
+		occupancy += (*it)->size();
+	}
+	return occupancy;
+}
+
+
+
+size_t FilterWorker::getOverflows() const {
+	size_t overflows = 0;
+	for (vector<UrlRing*>::const_iterator it = _rings.begin();
+			it != _rings.end(); it++)
+	{
+		overflows += (*it)->getOverflows();
+	}
+	return overflows;
+}
+
+
+
+Poco::UInt64 FilterWorker::getProcessed() const {
+	return _processed.load();
+}
+
+
+
+void FilterWorker::logStats() {
+	*_logStream <<"Filter worker " <<_id <<": " <<_processed.load() <<" filtered";
+	for (size_t i = 0; i < _rings.size(); i++) {
+		*_logStream <<", ring " <<i <<" " <<_rings[i]->size() <<"/"
+				<<_rings[i]->capacity() <<" (high " <<_rings[i]->getHighWater()
+				<<", overflows " <<_rings[i]->getOverflows() <<")";
+	}
+	*_logStream <<endl;
+	if (_id == 0 && _filter->getUrlsScanned() > 0) {
+		*_logStream <<"Filter: " <<_filter->getUrlsScanned() <<" URLs, "
+				<<(double)_filter->getKeywordsConfirmed() / _filter->getUrlsScanned()
+				<<" keywords confirmed and "
+				<<(double)_filter->getKeywordsSkipped() / _filter->getUrlsScanned()
+				<<" skipped per URL" <<endl;
+	}
+	if (_id == 0) {
+		logCacheStats("Verdict cache", _filter->getVerdictCache());
+		logCacheStats("Host cache", _filter->getHostCache());
+	}
+	_lastStats.update();
+}
@@ -33,6 +33,11 @@ History::~History() {
 
 
 
+HistoryHandler::~HistoryHandler() {
+}
+
+
+
 void History::setRows(vector<HistoryRow, allocator<HistoryRow> > &rows) {
 	_historyRows = rows;
 }
@@ -126,6 +131,30 @@ Timestamp History::getDateTime(int index) const {
 
 
 
+int History::getHits() const {
+	return getHits(_index);
+}
+
+
+
+int History::getHits(int index) const {
+	return _historyRows[index].hits;
+}
+
+
+
+Timestamp History::getLastSeen() const {
+	return getLastSeen(_index);
+}
+
+
+
+Timestamp History::getLastSeen(int index) const {
+	return _historyRows[index].lastSeen;
+}
+
+
+
 string History::getDateTime(string fmt) const {
 	return getDateTime(fmt, _index);
 }
@@ -0,0 +1,121 @@
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <HttpParser> extracts the request line and Host header of an HTTP request
+
+
+#include "HttpParser.h"
+
+
+
+bool HttpParser::parse(const char* data, size_t length,
+		HttpRequestView& request)
+{
+	request.clear();
+	const char *p = data,
+		*end = data + length,
+		*target,
+		*eol,
+		*lineEnd,
+		*value,
+		*valueEnd;
+
+	size_t m = methodLength(data, length);
+	if (m == 0)
+		return false;
+	p += m + 1;
+
+	/* request-target */
+	target = p;
+	while (p < end && *p != ' ') {
+		if (*p == '\r' || *p == '\n')
+			return false;
+		p++;
+	}
+	if (p == end || p == target)
+		return false;
+	p++;
+	if (end - p < 5 || memcmp(p, "HTTP/", 5) != 0)
+		return false;
+	request.method = string_view(data, m);
+	request.target = string_view(target, p - 1 - target);
+
+	/* headers, until the Host header or the end of the head */
+	p = (const char*)memchr(p, '\n', end - p);
+	while (p != 0 && ++p < end) {
+		eol = (const char*)memchr(p, '\n', end - p);
+		lineEnd = (eol != 0 ? eol : end);
+		if (lineEnd > p && lineEnd[-1] == '\r')
+			lineEnd--;
+		if (lineEnd == p)
+			break;
+		if (lineEnd - p >= 5 && (p[0] | 0x20) == 'h' && (p[1] | 0x20) == 'o'
+				&& (p[2] | 0x20) == 's' && (p[3] | 0x20) == 't' && p[4] == ':')
+		{
+			value = p + 5;
+			while (value < lineEnd && (*value == ' ' || *value == '\t'))
+				value++;
+			valueEnd = lineEnd;
+			while (valueEnd > value && (valueEnd[-1] == ' ' || valueEnd[-1] == '\t'))
+				valueEnd--;
+			request.host = string_view(value, valueEnd - value);
+			break;
+		}
+		p = eol;
+	}
+	return true;
+}
+
+
+
+size_t HttpParser::methodLength(const char* p, size_t length) {
+	if (length < 4)
+		return 0;
+	switch (p[0]) {
+		case 'G':
+			return (p[1] == 'E' && p[2] == 'T' && p[3] == ' ' ? 3 : 0);
+		case 'P':
+			if (p[1] == 'U' && p[2] == 'T' && p[3] == ' ')
+				return 3;
+			if (length >= 5 && memcmp(p, "POST ", 5) == 0)
+				return 4;
+			if (length >= 6 && memcmp(p, "PATCH ", 6) == 0)
+				return 5;
+			return 0;
+		case 'H':
+			return (length >= 5 && memcmp(p, "HEAD ", 5) == 0 ? 4 : 0);
+		case 'D':
+			return (length >= 7 && memcmp(p, "DELETE ", 7) == 0 ? 6 : 0);
+		case 'O':
+			return (length >= 8 && memcmp(p, "OPTIONS ", 8) == 0 ? 7 : 0);
+		default:
+			return 0;
+	}
+}
+
+
+
+const char* HttpParser::findHeadEnd(const char* data, size_t length) {
+	const char *p = data,
+		*end = data + length;
+	while ((p = (const char*)memchr(p, '\n', end - p)) != 0) {
+		p++;
+		if (p < end && *p == '\n')
+			return p + 1;
+		if (p + 1 < end && p[0] == '\r' && p[1] == '\n')
+			return p + 2;
+	}
+	return 0;
+}
@@ -0,0 +1,85 @@
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <KeywordTable> gives keywords and categories small IDs instead of strings
+
+
+#include "KeywordTable.h"
+
+
+
+Poco::FastMutex KeywordTable::_mutex;
+deque<string> KeywordTable::_strings;
+unordered_map<string, Poco::UInt32> KeywordTable::_ids;
+
+
+
+Poco::UInt32 KeywordTable::intern(const string& text) {
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	unordered_map<string, Poco::UInt32>::iterator it = _ids.find(text);
+	if (it != _ids.end())
+		return it->second;
+	_strings.push_back(text);
+	_ids[text] = (Poco::UInt32)(_strings.size() - 1);
+	return (Poco::UInt32)(_strings.size() - 1);
+}
+
+
+
+const string& KeywordTable::lookup(Poco::UInt32 id) {
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	return _strings[id];
+}
+
+
+
+KeywordHits::KeywordHits() {
+	_size = 0;
+}
+
+
+
+void KeywordHits::push_back(const KeywordHit& hit) {
+	if (_size < KEYWORD_HITS_INLINE)
+		_inline[_size] = hit;
+	else
+		_more.push_back(hit);
+	_size++;
+}
+
+
+
+void KeywordHits::clear() {
+	_more.clear();
+	_size = 0;
+}
+
+
+
+size_t KeywordHits::size() const {
+	return _size;
+}
+
+
+
+bool KeywordHits::empty() const {
+	return _size == 0;
+}
+
+
+
+const KeywordHit& KeywordHits::operator [] (size_t i) const {
+	return i < KEYWORD_HITS_INLINE ? _inline[i] : _more[i - KEYWORD_HITS_INLINE];
+}
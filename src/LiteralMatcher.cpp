@@ -0,0 +1,300 @@
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <LiteralMatcher> finds many literal strings in a single pass over a URL
+
+
+#include "LiteralMatcher.h"
+
+#include <cctype>
+#include <cstring>
+#include <deque>
+
+
+
+LiteralMatcher::LiteralMatcher() {
+	memset(_class, 0, sizeof(_class));
+	_classCount = 1;
+	_next.assign(1, 0);
+	_outputStart.assign(2, 0);
+}
+
+
+
+int LiteralMatcher::add(const string& literal) {
+	string lower = literal;
+	for (string::iterator it = lower.begin(); it != lower.end(); it++)
+		*it = tolower((unsigned char)*it);
+
+	map<string, int>::iterator found = _ids.find(lower);
+	if (found != _ids.end())
+		return found->second;
+	_ids[lower] = _literals.size();
+	_literals.push_back(lower);
+	return _literals.size() - 1;
+}
+
+
+
+void LiteralMatcher::compile() {
+	vector< vector<int> > outputs(1);
+	vector<int> fail(1, 0);
+	deque<int> queue;
+	int state, child, c;
+
+	/* every byte used by a literal gets its own class, the rest share 0 */
+	memset(_class, 0, sizeof(_class));
+	_classCount = 1;
+	for (vector<string>::iterator l = _literals.begin(); l != _literals.end(); l++) {
+		for (string::iterator it = l->begin(); it != l->end(); it++) {
+			if (_class[(unsigned char)*it] == 0)
+				_class[(unsigned char)*it] = _classCount++;
+		}
+	}
+	for (c = 'A'; c <= 'Z'; c++)
+		_class[c] = _class[c - 'A' + 'a'];
+
+	/* the trie */
+	_next.assign(_classCount, -1);
+	for (size_t id = 0; id < _literals.size(); id++) {
+		state = 0;
+		for (string::iterator it = _literals[id].begin();
+				it != _literals[id].end(); it++)
+		{
+			c = _class[(unsigned char)*it];
+			if (_next[state * _classCount + c] < 0) {
+				_next[state * _classCount + c] = outputs.size();
+				_next.resize(_next.size() + _classCount, -1);
+				outputs.push_back(vector<int>());
+				fail.push_back(0);
+			}
+			state = _next[state * _classCount + c];
+		}
+		outputs[state].push_back(id);
+	}
+
+	/* fill in the missing transitions breadth first, so the state a
+	 * failure leads to is always complete before it's used */
+	for (c = 0; c < _classCount; c++) {
+		child = _next[c];
+		if (child < 0)
+			_next[c] = 0;
+		else
+			queue.push_back(child);
+	}
+	while (!queue.empty()) {
+		state = queue.front();
+		queue.pop_front();
+		outputs[state].insert(outputs[state].end(),
+				outputs[fail[state]].begin(), outputs[fail[state]].end());
+		for (c = 0; c < _classCount; c++) {
+			child = _next[state * _classCount + c];
+			if (child < 0)
+				_next[state * _classCount + c] = _next[fail[state] * _classCount + c];
+			else {
+				fail[child] = _next[fail[state] * _classCount + c];
+				queue.push_back(child);
+			}
+		}
+	}
+
+	_outputStart.assign(1, 0);
+	_outputs.clear();
+	for (size_t s = 0; s < outputs.size(); s++) {
+		_outputs.insert(_outputs.end(), outputs[s].begin(), outputs[s].end());
+		_outputStart.push_back(_outputs.size());
+	}
+}
+
+
+
+void LiteralMatcher::scan(const char* text, size_t length,
+		vector<char>& found) const
+{
+	const unsigned char *p = (const unsigned char*)text,
+		*end = p + length;
+	int state = 0;
+
+	found.assign(_literals.size(), 0);
+	if (_literals.empty())
+		return;
+	for (; p < end; p++) {
+		state = _next[state * _classCount + _class[*p]];
+		for (int o = _outputStart[state]; o < _outputStart[state + 1]; o++)
+			found[_outputs[o]] = 1;
+	}
+}
+
+
+
+size_t LiteralMatcher::getLiteralCount() const {
+	return _literals.size();
+}
+
+
+
+size_t LiteralMatcher::getStateCount() const {
+	return _next.size() / _classCount;
+}
+
+
+
+string LiteralMatcher::extractLiteral(const string& pattern) {
+	string best,
+		run;
+	size_t i = 0,
+		next,
+		n = pattern.length();
+	int literal,
+		depth;
+	bool isOptional,
+		isRepeated;
+
+	/* quoting and inline options may change what the characters mean */
+	if (pattern.find("\\Q") != string::npos)
+		return "";
+	for (size_t p = pattern.find("(?"); p != string::npos;
+			p = pattern.find("(?", p + 2))
+	{
+		if (p + 2 >= n || pattern[p + 2] != ':')
+			return "";
+	}
+
+	while (i < n) {
+		literal = -1;
+		next = i + 1;
+		switch (pattern[i]) {
+			case '\\':
+				if (i + 1 >= n)
+					return "";
+				next = i + 2;
+				if (!isalnum((unsigned char)pattern[i + 1]))
+					literal = (unsigned char)pattern[i + 1];
+				else if (strchr("xcpPgkoNu0123456789E", pattern[i + 1]) != 0)
+					return "";
+				break;
+			case '[':
+				next = skipClass(pattern, i);
+				if (next == string::npos)
+					return "";
+				break;
+			case '(':
+				depth = 1;
+				while (next < n && depth > 0) {
+					if (pattern[next] == '\\')
+						next += 2;
+					else if (pattern[next] == '[') {
+						next = skipClass(pattern, next);
+						if (next == string::npos)
+							return "";
+					}
+					else {
+						if (pattern[next] == '(')
+							depth++;
+						else if (pattern[next] == ')')
+							depth--;
+						next++;
+					}
+				}
+				if (depth > 0)
+					return "";
+				break;
+			case '|':
+			case ')':
+				return "";
+			case '.':
+			case '^':
+			case '$':
+			case '{':
+			case '*':
+			case '+':
+			case '?':
+				break;
+			default:
+				literal = (unsigned char)pattern[i];
+		}
+
+		/* the quantifier, if any, of what was just read */
+		isOptional = isRepeated = false;
+		if (next < n) {
+			if (pattern[next] == '*' || pattern[next] == '?') {
+				isOptional = true;
+				next++;
+			}
+			else if (pattern[next] == '+') {
+				isRepeated = true;
+				next++;
+			}
+			else if (pattern[next] == '{') {
+				size_t j = next + 1;
+				int min = 0;
+				bool hasDigits = false;
+				while (j < n && isdigit((unsigned char)pattern[j])) {
+					min = min * 10 + (pattern[j++] - '0');
+					hasDigits = true;
+				}
+				if (hasDigits && j < n && pattern[j] == ',') {
+					j++;
+					while (j < n && isdigit((unsigned char)pattern[j]))
+						j++;
+				}
+				if (hasDigits && j < n && pattern[j] == '}') {
+					isOptional = (min == 0);
+					isRepeated = (min > 0);
+					next = j + 1;
+				}
+			}
+			if ((isOptional || isRepeated) && next < n
+					&& (pattern[next] == '?' || pattern[next] == '+'))
+				next++;
+		}
+
+		if (literal >= 0 && !isOptional)
+			run += (char)tolower(literal);
+		if (literal < 0 || isOptional || isRepeated) {
+			if (run.length() > best.length())
+				best = run;
+			run.clear();
+		}
+		i = next;
+	}
+	if (run.length() > best.length())
+		best = run;
+	return (best.length() >= LITERAL_MIN_LEN ? best : "");
+}
+
+
+
+size_t LiteralMatcher::skipClass(const string& pattern, size_t i) {
+	size_t n = pattern.length();
+	i++;
+	if (i < n && pattern[i] == '^')
+		i++;
+	if (i < n && pattern[i] == ']')
+		i++;
+	while (i < n && pattern[i] != ']') {
+		if (pattern[i] == '\\')
+			i += 2;
+		else if (pattern[i] == '[' && i + 1 < n && pattern[i + 1] == ':') {
+			i = pattern.find(":]", i + 2);
+			if (i == string::npos)
+				return string::npos;
+			i += 2;
+		}
+		else
+			i++;
+	}
+	return (i < n ? i + 1 : string::npos);
+}
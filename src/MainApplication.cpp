@@ -320,17 +320,23 @@ void MainApplication::signalHandler(int sig) {
 		case SIGHUP:
 		case SIGKILL:
 		case SIGTERM:
-			//Log Shutdown!
-			_instance->_database->logSessionStop();
-			terminateNicely(true);
+			//Only ask the sniffer to stop, the shutdown itself isn't safe in
+			//a signal handler. Without a sniffer, die as the signal would.
+			if (!Sniffer::requestStop()) {
+				struct sigaction dfl;
+				dfl.sa_handler = SIG_DFL;
+				sigemptyset(&dfl.sa_mask);
+				dfl.sa_flags = 0;
+				sigaction(sig, &dfl, 0);
+				raise(sig);
+			}
 			break;
 		case SIGCONT:
 			//Continued, means stopped
 			break;
 		case SIGUSR1:
-			//Resetting Net Responsibility
-			_instance->uninitialize();
-			_instance->initialize(*_instance);
+			//Reload the blacklist, without stopping the sniffer
+			FilterLoader::requestReload();
 			break;
 		case SIGUSR2:
 			//Other action or just mask it
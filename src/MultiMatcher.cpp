@@ -0,0 +1,792 @@
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <MultiMatcher> runs many regular expressions in a single pass over a URL
+
+
+#include "MultiMatcher.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+
+
+
+class MultiMatcher::Parser
+	/// Parses a single pattern into a syntax tree of Nodes, or fails on
+	/// anything MultiMatcher doesn't understand.
+{
+	public:
+		Parser(MultiMatcher& matcher, const string& pattern)
+			: _matcher(matcher), _p(pattern)
+		{
+			_i = 0;
+			_end = pattern.length();
+			_ok = true;
+		}
+
+		vector<Node> nodes;
+
+		bool parse(int& root, bool& isAnchoredStart, bool& isAnchoredEnd)
+		{
+			size_t slashes = 0;
+			isAnchoredStart = (_end > 0 && _p[0] == '^');
+			if (isAnchoredStart)
+				_i = 1;
+			if (_end > _i && _p[_end - 1] == '$') {
+				while (slashes + 2 <= _end && _p[_end - 2 - slashes] == '\\')
+					slashes++;
+				isAnchoredEnd = (slashes % 2 == 0);
+			}
+			else
+				isAnchoredEnd = false;
+			if (isAnchoredEnd)
+				_end--;
+
+			root = alternation(0);
+			if (!_ok || _i != _end)
+				return false;
+			/* ^a|b only anchors the first branch */
+			if ((isAnchoredStart || isAnchoredEnd) && nodes[root].type == Node::ALT)
+				return false;
+			return true;
+		}
+
+	private:
+		MultiMatcher &_matcher;
+		const string &_p;
+		size_t _i;
+		size_t _end;
+		bool _ok;
+
+		int node(int type)
+		{
+			nodes.push_back(Node());
+			nodes.back().type = static_cast<decltype(nodes.back().type)>(type);
+			nodes.back().set = nodes.back().min = nodes.back().max = 0;
+			return nodes.size() - 1;
+		}
+
+		int setNode(bitset<256> set)
+		{
+			fold(set);
+			int n = node(Node::SET);
+			nodes[n].set = _matcher.internSet(set);
+			return n;
+		}
+
+		int fail()
+		{
+			_ok = false;
+			return node(Node::EMPTY);
+		}
+
+		int alternation(int depth)
+		{
+			vector<int> branches;
+			branches.push_back(concatenation(depth));
+			while (_ok && _i < _end && _p[_i] == '|') {
+				_i++;
+				branches.push_back(concatenation(depth));
+			}
+			if (branches.size() == 1)
+				return branches[0];
+			int n = node(Node::ALT);
+			nodes[n].children = branches;
+			return n;
+		}
+
+		int concatenation(int depth)
+		{
+			vector<int> children;
+			while (_ok && _i < _end && _p[_i] != '|') {
+				if (_p[_i] == ')') {
+					if (depth == 0)
+						return fail();
+					break;
+				}
+				children.push_back(repetition(depth));
+			}
+			if (children.size() == 1)
+				return children[0];
+			int n = node(Node::CAT);
+			nodes[n].children = children;
+			return n;
+		}
+
+		int repetition(int depth)
+		{
+			int child = atom(depth),
+				min = -1,
+				max = -1;
+			if (!_ok || _i >= _end)
+				return child;
+
+			switch (_p[_i]) {
+				case '*': min = 0; max = -1; _i++; break;
+				case '+': min = 1; max = -1; _i++; break;
+				case '?': min = 0; max = 1; _i++; break;
+				case '{':
+					if (!quantifier(min, max))
+						return child;
+					break;
+				default:
+					return child;
+			}
+			if (_i < _end && _p[_i] == '?')
+				_i++;
+			else if (_i < _end && _p[_i] == '+')
+				return fail();		// possessive
+			if (_i < _end && (_p[_i] == '*' || _p[_i] == '+' || _p[_i] == '?'
+					|| (_p[_i] == '{' && isQuantifier())))
+				return fail();
+			if (min > MULTI_MAX_REPEAT || max > MULTI_MAX_REPEAT)
+				return fail();
+
+			int n = node(Node::REPEAT);
+			nodes[n].min = min;
+			nodes[n].max = max;
+			nodes[n].children.push_back(child);
+			return n;
+		}
+
+		bool isQuantifier()
+		{
+			size_t i = _i;
+			int min, max;
+			bool is = quantifier(min, max);
+			_i = i;
+			return is;
+		}
+
+		bool quantifier(int& min, int& max)
+			/// Read {n}, {n,} or {n,m} at _i. Anything else starting with '{'
+			/// is taken literally by PCRE, except {,m} in newer versions.
+		{
+			size_t i = _i + 1;
+			if (i < _end && _p[i] == ',') {
+				_ok = false;
+				return false;
+			}
+			if (!readNumber(i, min))
+				return false;
+			max = min;
+			if (i < _end && _p[i] == ',') {
+				i++;
+				max = -1;
+				if (i < _end && isdigit((unsigned char)_p[i]) && !readNumber(i, max))
+					return false;
+			}
+			if (i >= _end || _p[i] != '}')
+				return false;
+			if (max != -1 && max < min) {
+				_ok = false;
+				return false;
+			}
+			_i = i + 1;
+			return true;
+		}
+
+		bool readNumber(size_t& i, int& number)
+		{
+			size_t start = i;
+			number = 0;
+			while (i < _end && isdigit((unsigned char)_p[i]) && i - start < 6)
+				number = number * 10 + (_p[i++] - '0');
+			return i > start;
+		}
+
+		int atom(int depth)
+		{
+			bitset<256> set;
+			int n;
+			switch (_p[_i]) {
+				case '(':
+					_i++;
+					if (_i < _end && _p[_i] == '?') {
+						if (_i + 1 < _end && _p[_i + 1] == ':')
+							_i += 2;
+						else
+							return fail();
+					}
+					n = alternation(depth + 1);
+					if (!_ok || _i >= _end || _p[_i] != ')')
+						return fail();
+					_i++;
+					return n;
+				case '[':
+					_i++;
+					if (!characterClass(set))
+						return fail();
+					return setNode(set);
+				case '.':
+					_i++;
+					set.set();
+					set.reset('\n');
+					return setNode(set);
+				case '\\':
+					_i++;
+					if (!escape(set, false))
+						return fail();
+					return setNode(set);
+				case '^':
+				case '$':
+				case '*':
+				case '+':
+				case '?':
+					return fail();
+				default:
+					set.set((unsigned char)_p[_i++]);
+					return setNode(set);
+			}
+		}
+
+		bool escape(bitset<256>& set, bool isInClass)
+			/// Read the escape after a backslash at _i into set.
+		{
+			if (_i >= _end)
+				return false;
+			unsigned char c = _p[_i++];
+			int value, digits;
+			switch (c) {
+				case 'd':
+				case 'w':
+				case 's':
+					shorthand(set, c);
+					return true;
+				case 'D':
+				case 'W':
+				case 'S':
+					{
+						bitset<256> positive;
+						shorthand(positive, tolower(c));
+						set |= ~positive;
+					}
+					return true;
+				case 't': set.set('\t'); return true;
+				case 'n': set.set('\n'); return true;
+				case 'r': set.set('\r'); return true;
+				case 'f': set.set('\f'); return true;
+				case 'e': set.set(0x1b); return true;
+				case 'a': set.set(0x07); return true;
+				case 'b':
+					if (!isInClass)
+						return false;
+					set.set(0x08);
+					return true;
+				case 'x':
+					if (_i < _end && _p[_i] == '{')
+						return false;
+					value = digits = 0;
+					while (digits < 2 && _i < _end && isxdigit((unsigned char)_p[_i])) {
+						value = value * 16 + (isdigit((unsigned char)_p[_i])
+								? _p[_i] - '0' : tolower(_p[_i]) - 'a' + 10);
+						_i++;
+						digits++;
+					}
+					set.set(value);
+					return true;
+				case '0':
+					value = digits = 0;
+					while (digits < 2 && _i < _end && _p[_i] >= '0' && _p[_i] <= '7') {
+						value = value * 8 + (_p[_i++] - '0');
+						digits++;
+					}
+					set.set(value);
+					return true;
+				default:
+					if (isalnum(c) || c >= 0x80)
+						return false;
+					set.set(c);
+					return true;
+			}
+		}
+
+		static void shorthand(bitset<256>& set, char letter)
+			/// Add the characters of \d, \w or \s to set.
+		{
+			switch (letter) {
+				case 'w':
+					range(set, 'a', 'z');
+					range(set, 'A', 'Z');
+					set.set('_');
+					// fall through
+				case 'd':
+					range(set, '0', '9');
+					break;
+				case 's':
+					set.set(' ');
+					range(set, '\t', '\r');
+					break;
+			}
+		}
+
+		bool characterClass(bitset<256>& set)
+			/// Read the class after '[' at _i into set.
+		{
+			bitset<256> item;
+			bool isNegated = false,
+				isFirst = true;
+			int from, to;
+
+			if (_i < _end && _p[_i] == '^') {
+				isNegated = true;
+				_i++;
+			}
+			while (_i < _end && (_p[_i] != ']' || isFirst)) {
+				isFirst = false;
+				if (_p[_i] == '[' && _i + 1 < _end
+						&& (_p[_i + 1] == ':' || _p[_i + 1] == '.' || _p[_i + 1] == '='))
+					return false;
+				if (!classAtom(item, from))
+					return false;
+				if (from >= 0 && _i + 1 < _end && _p[_i] == '-' && _p[_i + 1] != ']') {
+					_i++;
+					item.reset();
+					if (!classAtom(item, to) || to < 0 || to < from)
+						return false;
+					range(set, from, to);
+				}
+				else
+					set |= item;
+				item.reset();
+			}
+			if (_i >= _end)
+				return false;
+			_i++;
+			fold(set);
+			if (isNegated)
+				set.flip();
+			return true;
+		}
+
+		bool classAtom(bitset<256>& item, int& value)
+			/// Read a single character, or an escape, in a class. value is the
+			/// character, or -1 if it was a set like \d.
+		{
+			if (_p[_i] != '\\') {
+				value = (unsigned char)_p[_i++];
+				item.set(value);
+				return true;
+			}
+			_i++;
+			if (!escape(item, true))
+				return false;
+			value = (item.count() == 1 ? (int)firstOf(item) : -1);
+			return true;
+		}
+
+		static size_t firstOf(const bitset<256>& set)
+		{
+			for (size_t b = 0; b < 256; b++) {
+				if (set.test(b))
+					return b;
+			}
+			return 0;
+		}
+
+		static void range(bitset<256>& set, int from, int to)
+		{
+			for (int b = from; b <= to; b++)
+				set.set(b);
+		}
+
+		static void fold(bitset<256>& set)
+			/// Make set caseless, the way PCRE does without UTF-8.
+		{
+			for (int b = 'a'; b <= 'z'; b++) {
+				if (set.test(b) || set.test(b - 'a' + 'A')) {
+					set.set(b);
+					set.set(b - 'a' + 'A');
+				}
+			}
+		}
+};
+
+
+
+static std::atomic<Poco::UInt64> multiMatcherSerial(0);
+
+
+
+MultiMatcher::Cache::Cache() {
+	serial = 0;
+	mark = 0;
+	size = 0;
+	initial = 0;
+	resets = 0;
+}
+
+
+
+MultiMatcher::MultiMatcher() {
+	_patternCount = 0;
+	_classCount = 1;
+	_serial = 0;
+	memset(_class, 0, sizeof(_class));
+	memset(_representative, 0, sizeof(_representative));
+}
+
+
+
+int MultiMatcher::add(const string& pattern) {
+	Parser parser(*this, pattern);
+	int root;
+	bool isAnchoredStart,
+		isAnchoredEnd;
+	size_t before = _states.size();
+
+	if (!parser.parse(root, isAnchoredStart, isAnchoredEnd))
+		return -1;
+
+	Fragment fragment = build(parser.nodes, root);
+	patch(fragment.exits, addState(isAnchoredEnd ? STATE_MATCH_END : STATE_MATCH,
+			_patternCount, -1, -1));
+	if (_states.size() - before > MULTI_MAX_PATTERN_STATES) {
+		_states.resize(before);
+		return -1;
+	}
+	if (isAnchoredStart)
+		_anchoredStarts.push_back(fragment.start);
+	else
+		_starts.push_back(fragment.start);
+	return _patternCount++;
+}
+
+
+
+void MultiMatcher::compile() {
+	map<string, int> signatures;
+	string signature;
+	Cache cache;
+
+	/* bytes no set tells apart share a class */
+	_classCount = 0;
+	for (int b = 0; b < 256; b++) {
+		signature.assign(_sets.size(), '0');
+		for (size_t s = 0; s < _sets.size(); s++) {
+			if (_sets[s].test(b))
+				signature[s] = '1';
+		}
+		map<string, int>::iterator it = signatures.find(signature);
+		if (it == signatures.end()) {
+			_representative[_classCount] = b;
+			it = signatures.insert(make_pair(signature, _classCount++)).first;
+		}
+		_class[b] = it->second;
+	}
+
+	/* the states every DFA state implicitly holds, to find matches
+	 * starting anywhere */
+	cache.marks.assign(_states.size(), 0);
+	closure(_starts, cache, _base);
+	_isBase.assign(_states.size(), 0);
+	_baseOutputs.clear();
+	_baseEndOutputs.clear();
+	for (vector<int>::iterator s = _base.begin(); s != _base.end(); s++) {
+		_isBase[*s] = 1;
+		if (_states[*s].type == STATE_MATCH)
+			_baseOutputs.push_back(_states[*s].arg);
+		else if (_states[*s].type == STATE_MATCH_END)
+			_baseEndOutputs.push_back(_states[*s].arg);
+	}
+	_serial = ++multiMatcherSerial;
+}
+
+
+
+void MultiMatcher::scan(const char* text, size_t length, Cache& cache,
+		vector<char>& matched) const
+{
+	const unsigned char *p = (const unsigned char*)text;
+	vector<int>::const_iterator o;
+	int state,
+		next;
+
+	matched.assign(_patternCount, 0);
+	if (_patternCount == 0)
+		return;
+	if (cache.serial != _serial)
+		reset(cache);
+
+	for (o = _baseOutputs.begin(); o != _baseOutputs.end(); o++)
+		matched[*o] = 1;
+	state = cache.initial;
+	for (o = cache.outputs[state].begin(); o != cache.outputs[state].end(); o++)
+		matched[*o] = 1;
+
+	for (size_t i = 0; i < length; i++) {
+		/* $ also matches before a newline ending the text */
+		if (i + 1 == length && p[i] == '\n') {
+			for (o = cache.endOutputs[state].begin();
+					o != cache.endOutputs[state].end(); o++)
+				matched[*o] = 1;
+			for (o = _baseEndOutputs.begin(); o != _baseEndOutputs.end(); o++)
+				matched[*o] = 1;
+		}
+		next = cache.next[state * _classCount + _class[p[i]]];
+		if (next < 0)
+			next = step(cache, state, _class[p[i]]);
+		state = next;
+		for (o = cache.outputs[state].begin(); o != cache.outputs[state].end(); o++)
+			matched[*o] = 1;
+	}
+
+	for (o = cache.endOutputs[state].begin(); o != cache.endOutputs[state].end(); o++)
+		matched[*o] = 1;
+	for (o = _baseEndOutputs.begin(); o != _baseEndOutputs.end(); o++)
+		matched[*o] = 1;
+}
+
+
+
+size_t MultiMatcher::getPatternCount() const {
+	return _patternCount;
+}
+
+
+
+size_t MultiMatcher::getNfaStateCount() const {
+	return _states.size();
+}
+
+
+
+int MultiMatcher::internSet(const bitset<256>& set) {
+	string key = set.to_string();
+	map<string, int>::iterator it = _setIds.find(key);
+	if (it != _setIds.end())
+		return it->second;
+	_sets.push_back(set);
+	_setIds[key] = _sets.size() - 1;
+	return _sets.size() - 1;
+}
+
+
+
+int MultiMatcher::addState(int type, int arg, int out, int out1) {
+	State state;
+	state.type = type;
+	state.arg = arg;
+	state.out = out;
+	state.out1 = out1;
+	_states.push_back(state);
+	return _states.size() - 1;
+}
+
+
+
+MultiMatcher::Fragment MultiMatcher::build(const vector<Node>& nodes, int n) {
+	Fragment fragment,
+		part;
+	const Node &node = nodes[n];
+	int s;
+	bool isEmpty = true;
+
+	switch (node.type) {
+		case Node::SET:
+			fragment.start = addState(STATE_CHAR, node.set, -1, -1);
+			fragment.exits.push_back(fragment.start * 2);
+			return fragment;
+
+		case Node::ALT:
+			for (size_t c = 0; c < node.children.size(); c++) {
+				part = build(nodes, node.children[c]);
+				if (c == 0)
+					fragment = part;
+				else {
+					fragment.start = addState(STATE_SPLIT, 0, fragment.start, part.start);
+					fragment.exits.insert(fragment.exits.end(),
+							part.exits.begin(), part.exits.end());
+				}
+			}
+			return fragment;
+
+		case Node::CAT:
+			for (size_t c = 0; c < node.children.size(); c++) {
+				part = build(nodes, node.children[c]);
+				if (isEmpty)
+					fragment = part;
+				else {
+					patch(fragment.exits, part.start);
+					fragment.exits = part.exits;
+				}
+				isEmpty = false;
+			}
+			break;
+
+		case Node::REPEAT:
+			/* x{2,4} is built as xxx?x? and x{2,} as xxx* */
+			for (int i = 0; i < node.min || i < node.max || (i == node.min
+					&& node.max < 0); i++)
+			{
+				part = build(nodes, node.children[0]);
+				if (i >= node.min) {
+					s = addState(STATE_SPLIT, 0, part.start, -1);
+					if (node.max < 0) {
+						patch(part.exits, s);
+						part.exits.clear();
+					}
+					part.exits.push_back(s * 2 + 1);
+					part.start = s;
+				}
+				if (isEmpty)
+					fragment = part;
+				else {
+					patch(fragment.exits, part.start);
+					fragment.exits = part.exits;
+				}
+				isEmpty = false;
+			}
+			break;
+
+		case Node::EMPTY:
+			break;
+	}
+
+	if (isEmpty) {
+		fragment.start = addState(STATE_SPLIT, 0, -1, -1);
+		fragment.exits.assign(1, fragment.start * 2);
+	}
+	return fragment;
+}
+
+
+
+void MultiMatcher::patch(const vector<int>& exits, int target) {
+	for (vector<int>::const_iterator e = exits.begin(); e != exits.end(); e++) {
+		if (*e % 2 == 0)
+			_states[*e / 2].out = target;
+		else
+			_states[*e / 2].out1 = target;
+	}
+}
+
+
+
+void MultiMatcher::closure(const vector<int>& from, Cache& cache,
+		vector<int>& to) const
+{
+	vector<int> stack(from);
+	int s;
+
+	if (++cache.mark == 0) {
+		cache.marks.assign(cache.marks.size(), 0);
+		cache.mark = 1;
+	}
+	to.clear();
+	while (!stack.empty()) {
+		s = stack.back();
+		stack.pop_back();
+		if (s < 0 || cache.marks[s] == cache.mark)
+			continue;
+		cache.marks[s] = cache.mark;
+		if (_states[s].type == STATE_SPLIT) {
+			stack.push_back(_states[s].out1);
+			stack.push_back(_states[s].out);
+		}
+		else
+			to.push_back(s);
+	}
+}
+
+
+
+void MultiMatcher::reset(Cache& cache) const {
+	vector<int> initial;
+
+	if (cache.serial == _serial)
+		cache.resets++;
+	cache.serial = _serial;
+	cache.sets.clear();
+	cache.outputs.clear();
+	cache.endOutputs.clear();
+	cache.next.clear();
+	cache.index.clear();
+	cache.baseTargets.assign(_classCount, vector<int>());
+	cache.baseTargetsBuilt.assign(_classCount, 0);
+	cache.marks.assign(_states.size(), 0);
+	cache.mark = 0;
+	cache.size = 0;
+
+	closure(_anchoredStarts, cache, initial);
+	cache.initial = intern(cache, initial);
+}
+
+
+
+int MultiMatcher::intern(Cache& cache, vector<int>& set) const {
+	vector<int>::iterator s;
+	int index;
+
+	/* the base states are left out, since every DFA state has them */
+	set.erase(remove_if(set.begin(), set.end(), [this](int s) {
+			return _isBase[s] != 0; }), set.end());
+	sort(set.begin(), set.end());
+
+	map< vector<int>, int >::iterator it = cache.index.find(set);
+	if (it != cache.index.end())
+		return it->second;
+
+	index = cache.sets.size();
+	cache.sets.push_back(set);
+	cache.outputs.push_back(vector<int>());
+	cache.endOutputs.push_back(vector<int>());
+	for (s = set.begin(); s != set.end(); s++) {
+		if (_states[*s].type == STATE_MATCH)
+			cache.outputs.back().push_back(_states[*s].arg);
+		else if (_states[*s].type == STATE_MATCH_END)
+			cache.endOutputs.back().push_back(_states[*s].arg);
+	}
+	cache.next.resize(cache.next.size() + _classCount, -1);
+	cache.index[set] = index;
+	cache.size += 2 * set.size() + _classCount;
+	return index;
+}
+
+
+
+int MultiMatcher::step(Cache& cache, int state, int c) const {
+	vector<int> targets,
+		closed;
+	vector<int>::const_iterator s;
+	unsigned char b = _representative[c];
+	int next;
+
+	if (cache.size > MULTI_CACHE_LIMIT) {
+		closed = cache.sets[state];
+		reset(cache);
+		state = intern(cache, closed);
+	}
+
+	if (!cache.baseTargetsBuilt[c]) {
+		for (s = _base.begin(); s != _base.end(); s++) {
+			if (_states[*s].type == STATE_CHAR && _sets[_states[*s].arg].test(b))
+				cache.baseTargets[c].push_back(_states[*s].out);
+		}
+		cache.baseTargetsBuilt[c] = 1;
+	}
+	targets = cache.baseTargets[c];
+	for (s = cache.sets[state].begin(); s != cache.sets[state].end(); s++) {
+		if (_states[*s].type == STATE_CHAR && _sets[_states[*s].arg].test(b))
+			targets.push_back(_states[*s].out);
+	}
+
+	closure(targets, cache, closed);
+	next = intern(cache, closed);
+	cache.next[state * _classCount + c] = next;
+	return next;
+}
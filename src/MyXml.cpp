@@ -62,58 +62,110 @@ map<string, string> MyXml::getStringMap() const {
 
 
 Blacklist MyXml::getBlacklist() {
+	struct ParsedKeyword
+		/// A keyword read from the document, waiting for its patterns.
+	{
+		size_t category;
+		string key;
+		string line;
+		string error;
+			/// Set if the keyword couldn't be read.
+		size_t firstPattern;
+		vector<string> pattern;
+	};
+
 	string line;
 	Blacklist blacklist;
 	BlacklistCategory tempCategory;
 	BlacklistKeyword tempKeyword;
-	vector< SharedPtr<RegularExpression> > tempRe;
+	ParsedKeyword parsed;
+	vector<ParsedKeyword> parsedKeywords;
 	vector<string> categories, keywords;
+	PatternCompiler compiler(RegularExpression::RE_CASELESS);
 
-	int o,
-		options = RegularExpression::RE_CASELESS;
+	int o;
+	size_t p;
 	const int DEFAULT_STRENGTH = 100;
 	RegularExpression::Match m;
 	RegularExpression whitespace ("[^\\s]+", 0, true);
 
 	this->keys(categories);
-
+
+	/* read the whole document first, and compile every pattern at once */
 	for (vector<string>::iterator c = categories.begin();
 			c != categories.end(); c++)
-	{
+	{
 		if (this->hasProperty(*c + "[@name]")) {
 			tempCategory.name = this->getString(*c + "[@name]");
-			blacklist.push_back(tempCategory);
+			blacklist.push_back(tempCategory);
 			this->keys(*c, keywords);
 
 			for (vector<string>::iterator k = keywords.begin();
 					k != keywords.end(); k++)
-			{
-				tempRe.clear();
+			{
+				parsed.category = blacklist.size() - 1;
+				parsed.key = *c + '.' + *k;
+				parsed.error.clear();
+				parsed.pattern.clear();
+				parsed.firstPattern = 0;
 				try {
-					line = this->getString(*c + '.' + *k);
+					line = this->getString(parsed.key);
 					if (line.find(" ") != string::npos) {
 						o = 0;
 						while (whitespace.match(line, o, m)) {
-							tempRe.push_back(new RegularExpression
-									(line.substr(m.offset, m.length), options, true));
+							parsed.pattern.push_back(line.substr(m.offset, m.length));
 							o = m.offset + m.length;
 						}
 					}
 					else
-						tempRe.push_back(new RegularExpression(line, options, true));
+						parsed.pattern.push_back(line);
+				}
+				catch (Poco::Exception &err) {
+					parsed.error = err.displayText();
 				}
-				catch (Poco::Exception &err) {
-					_logger->information(err.displayText() + (string)": " + line);
-					continue;
+				parsed.line = line;
+				if (parsed.error.empty()) {
+					for (p = 0; p < parsed.pattern.size(); p++) {
+						if (p == 0)
+							parsed.firstPattern = compiler.add(parsed.pattern[p]);
+						else
+							compiler.add(parsed.pattern[p]);
+					}
 				}
-				tempKeyword.re = tempRe;
-				tempKeyword.asString = line;
+				parsedKeywords.push_back(parsed);
+			}
+		}
+	}
 
-				tempKeyword.strength = (this->hasProperty(*c + '.' + *k + "[@s]")
-						? this->getInt(*c + '.' + *k + "[@s]") : DEFAULT_STRENGTH);
-				blacklist.back().keyword.push_back(tempKeyword);
-			}
+	compiler.compile();
+
+	/* then put the keywords together in document order, skipping the ones
+	 * that couldn't be read or compiled, just as if it was done one by one */
+	for (vector<ParsedKeyword>::iterator k = parsedKeywords.begin();
+			k != parsedKeywords.end(); k++)
+	{
+		tempKeyword.re.clear();
+		tempKeyword.pattern.clear();
+		tempKeyword.literal.clear();
+		for (p = 0; p < k->pattern.size() && k->error.empty(); p++) {
+			if (compiler.get(k->firstPattern + p).isNull())
+				k->error = compiler.getError(k->firstPattern + p);
+			else {
+				tempKeyword.re.push_back(compiler.get(k->firstPattern + p));
+				tempKeyword.pattern.push_back(k->pattern[p]);
+				tempKeyword.literal.push_back(
+						LiteralMatcher::extractLiteral(k->pattern[p]));
+			}
 		}
+		if (!k->error.empty()) {
+			_logger->information(k->error + (string)": " + k->line);
+			continue;
+		}
+		tempKeyword.asString = k->line;
+
+		tempKeyword.strength = (this->hasProperty(k->key + "[@s]")
+				? this->getInt(k->key + "[@s]") : DEFAULT_STRENGTH);
+		blacklist[k->category].keyword.push_back(tempKeyword);
 	}
 	return blacklist;
 }
@@ -141,6 +193,7 @@ Extensions MyXml::getExtensions() {
 			_logger->information(err.displayText() + (string)": " + line);
 			continue;
 		}
+		tempExt.pattern = line;
 		tempExt.group = this->getString("extensions." + *k + "[@group]");
 		tempExt.strength = (this->hasProperty("extensions." + *k + "[@s]")
 				? this->getInt("extensions." + *k + "[@s]") : DEFAULT_STRENGTH);
@@ -177,6 +177,144 @@ int Options::getReportStrengthThreshold() const {
 
 
 
+string Options::getCaptureBackend() const {
+	return _captureBackend;
+}
+
+
+
+int Options::getCaptureRingBlockSize() const {
+	return _captureRingBlockSize;
+}
+
+
+
+int Options::getCaptureRingBlocks() const {
+	return _captureRingBlocks;
+}
+
+
+
+int Options::getCaptureRingTimeout() const {
+	return _captureRingTimeout;
+}
+
+
+
+int Options::getFilterWorkers() const {
+	return _filterWorkers;
+}
+
+
+
+int Options::getFilterRingSize() const {
+	return _filterRingSize;
+}
+
+
+
+int Options::getReassemblyFlows() const {
+	return _reassemblyFlows;
+}
+
+
+
+int Options::getReassemblyTimeout() const {
+	return _reassemblyTimeout;
+}
+
+
+
+int Options::getDbBatchSize() const {
+	return _dbBatchSize;
+}
+
+
+
+int Options::getDbBatchInterval() const {
+	return _dbBatchInterval;
+}
+
+
+
+bool Options::getDbPartitions() const {
+	return _dbPartitions;
+}
+
+
+
+int Options::getDbVacuumHour() const {
+	return _dbVacuumHour;
+}
+
+
+
+int Options::getDbCoalesceWindow() const {
+	return _dbCoalesceWindow;
+}
+
+
+
+string Options::getFilterEngine() const {
+	return _filterEngine;
+}
+
+
+
+bool Options::getBlacklistSnapshot() const {
+	return _blacklistSnapshot;
+}
+
+
+
+int Options::getBlacklistCheckInterval() const {
+	return _blacklistCheckInterval;
+}
+
+
+
+int Options::getVerdictCacheSize() const {
+	return _verdictCacheSize;
+}
+
+
+
+int Options::getHostCacheSize() const {
+	return _hostCacheSize;
+}
+
+
+
+int Options::getCacheShards() const {
+	return _cacheShards;
+}
+
+
+
+int Options::getDbQueueSize() const {
+	return _dbQueueSize;
+}
+
+
+
+string Options::getDbQueuePolicy() const {
+	return _dbQueuePolicy;
+}
+
+
+
+int Options::getDbCacheSize() const {
+	return _dbCacheSize;
+}
+
+
+
+int Options::getDbMmapSize() const {
+	return _dbMmapSize;
+}
+
+
+
 Bypasses &Options::getInitBypasses() const {
 	return *_initBypasses;
 }
@@ -200,6 +338,29 @@ void Options::loadDefaultValues() {
 	_version       = VERSION;
 	_saveHistory   = true;
 	_username      = "";
+	_captureBackend       = "pcap";
+	_captureRingBlockSize = 1 << 20;
+	_captureRingBlocks    = 64;
+	_captureRingTimeout   = 100;
+	_filterWorkers        = 2;
+	_filterRingSize       = 1024;
+	_reassemblyFlows      = 512;
+	_reassemblyTimeout    = 10;
+	_dbBatchSize          = 100;
+	_dbBatchInterval      = 1000;
+	_dbCoalesceWindow     = 5;
+	_dbVacuumHour         = 3;
+	_dbPartitions         = false;
+	_dbQueueSize          = 4096;
+	_filterEngine         = "pcre";
+	_blacklistSnapshot    = true;
+	_blacklistCheckInterval = 60;
+	_verdictCacheSize     = 8192;
+	_hostCacheSize        = 0;
+	_cacheShards          = 16;
+	_dbQueuePolicy        = "drop";
+	_dbCacheSize          = 8192;
+	_dbMmapSize           = 64;
 	_logger->debug("Version " + _version);
 }
 
@@ -223,6 +384,30 @@ void Options::loadConfigfile() {
 			_reportFrequency = xmlConfig->getInt("reportFrequency", 7);
 			_reportStrengthThreshold = xmlConfig->getInt("reportStrengthThreshold", 0);
 
+			_captureBackend       = xmlConfig->getString("captureBackend", "pcap");
+			_captureRingBlockSize = xmlConfig->getInt("captureRingBlockSize", 1 << 20);
+			_captureRingBlocks    = xmlConfig->getInt("captureRingBlocks", 64);
+			_captureRingTimeout   = xmlConfig->getInt("captureRingTimeout", 100);
+			_filterWorkers        = xmlConfig->getInt("filterWorkers", 2);
+			_filterRingSize       = xmlConfig->getInt("filterRingSize", 1024);
+			_reassemblyFlows      = xmlConfig->getInt("reassemblyFlows", 512);
+			_reassemblyTimeout    = xmlConfig->getInt("reassemblyTimeout", 10);
+			_dbBatchSize          = xmlConfig->getInt("dbBatchSize", 100);
+			_dbBatchInterval      = xmlConfig->getInt("dbBatchInterval", 1000);
+			_dbCoalesceWindow     = xmlConfig->getInt("dbCoalesceWindow", 5);
+			_dbVacuumHour         = xmlConfig->getInt("dbVacuumHour", 3);
+			_dbPartitions         = xmlConfig->getBool("dbPartitions", false);
+			_dbQueueSize          = xmlConfig->getInt("dbQueueSize", 4096);
+			_filterEngine         = xmlConfig->getString("filterEngine", "pcre");
+			_blacklistSnapshot    = xmlConfig->getBool("blacklistSnapshot", true);
+			_blacklistCheckInterval = xmlConfig->getInt("blacklistCheckInterval", 60);
+			_verdictCacheSize     = xmlConfig->getInt("verdictCacheSize", 8192);
+			_hostCacheSize        = xmlConfig->getInt("hostCacheSize", 0);
+			_cacheShards          = xmlConfig->getInt("cacheShards", 16);
+			_dbQueuePolicy        = xmlConfig->getString("dbQueuePolicy", "drop");
+			_dbCacheSize          = xmlConfig->getInt("dbCacheSize", 8192);
+			_dbMmapSize           = xmlConfig->getInt("dbMmapSize", 64);
+
 			_saveHistory = isAttachedReportPart("history_hostnames")
 					|| isAttachedReportPart("history_paths");
 
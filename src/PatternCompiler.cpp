@@ -0,0 +1,102 @@
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <PatternCompiler> compiles many regular expressions on several threads
+
+
+#include "PatternCompiler.h"
+
+#include "Poco/Environment.h"
+#include "Poco/ThreadPool.h"
+#include "Poco/Exception.h"
+
+
+
+PatternCompiler::PatternCompiler(int options) {
+	_options = options;
+	_next = 0;
+}
+
+
+
+size_t PatternCompiler::add(const string& pattern) {
+	_patterns.push_back(pattern);
+	return _patterns.size() - 1;
+}
+
+
+
+void PatternCompiler::compile() {
+	int threads = (int)Poco::Environment::processorCount();
+	if (threads > (int)(_patterns.size() / COMPILE_MIN_PATTERNS))
+		threads = (int)(_patterns.size() / COMPILE_MIN_PATTERNS);
+	if (threads > COMPILE_MAX_THREADS)
+		threads = COMPILE_MAX_THREADS;
+
+	_compiled.assign(_patterns.size(), SharedPtr<RegularExpression>());
+	_errors.assign(_patterns.size(), "");
+	_next = 0;
+	if (threads < 2) {
+		compileNext();
+		return;
+	}
+
+	/* a pool of its own, since the default pool is busy sniffing when the
+	 * blacklist is reloaded; this thread works too */
+	Poco::ThreadPool pool(threads - 1, threads - 1);
+	vector<Task> tasks(threads - 1, Task(this));
+	for (vector<Task>::iterator t = tasks.begin(); t != tasks.end(); t++)
+		pool.start(*t);
+	compileNext();
+	pool.joinAll();
+}
+
+
+
+SharedPtr<RegularExpression> PatternCompiler::get(size_t index) const {
+	return _compiled[index];
+}
+
+
+
+const string& PatternCompiler::getError(size_t index) const {
+	return _errors[index];
+}
+
+
+
+void PatternCompiler::compileNext() {
+	size_t i;
+	while ((i = _next.fetch_add(1)) < _patterns.size()) {
+		try {
+			_compiled[i] = new RegularExpression(_patterns[i], _options, true);
+		}
+		catch (Poco::Exception &err) {
+			_errors[i] = err.displayText();
+		}
+	}
+}
+
+
+
+PatternCompiler::Task::Task(PatternCompiler* compiler) {
+	_compiler = compiler;
+}
+
+
+
+void PatternCompiler::Task::run() {
+	_compiler->compileNext();
+}
@@ -43,6 +43,7 @@ string Report::name() const {
 void Report::generate() {
 	_contentType = "text/html";
 	string suspicious;
+	openAttachedReport();
 	makeWarningsSection(suspicious);
 	makeWhitelistSection();
 	makeHistorySection();
@@ -65,13 +66,11 @@ void Report::makeWarningsSection(string &suspicious) {
 		map<string, vector<int> > tree;
 		stringstream urlsContent,
 			attUrlsContent;
-		vector<BlacklistKeyword> keywords;
 		while (warnings.hasMore()) {
-			keywords = warnings.getKeywords();
-			for(vector<BlacklistKeyword>::iterator it = keywords.begin();
-					it != keywords.end(); it++)
-			{
-				key = it->asString + " (" + it->category + ")";
+			const KeywordHits &keywords = warnings.getKeywords();
+			for (size_t i = 0; i < keywords.size(); i++) {
+				key = KeywordTable::lookup(keywords[i].keyword) + " ("
+						+ KeywordTable::lookup(keywords[i].category) + ")";
 				tree[key].push_back(warnings.getIndex());
 			}
 			warnings.next();
@@ -216,11 +215,24 @@ void Report::makeHistorySection() {
 
 
 
+void Report::openAttachedReport() {
+	try {
+		_attached.create(REPORT_DIR);
+	}
+	catch (Exception &exc) {
+		cout <<exc.displayText() <<endl;
+	}
+	_attached << _options->getTxt("attachedReportHeader") <<endl
+			<<"var subject = \"" <<_subject <<"\";" <<endl
+			<<"var version = " <<_options->getVersion() <<";" <<endl
+			<<"var arrNodes = [['Report', ['',,'folder'], [" <<endl;
+}
+
+
+
 void Report::addTemplate(string suspicious) {
-	string bodyContent = _body.str(),
-			attachedContent = _attached.str();
+	string bodyContent = _body.str();
 	_body.str("");
-	_attached.str("");
 
 	_body <<"<a name='top'><h1>" <<_subject <<"</h1></a>" <<endl
 			<<_options->getTxt("reportGeneratedBy") <<"<br />" <<endl
@@ -232,61 +244,17 @@ void Report::addTemplate(string suspicious) {
 			<<"<hr />" <<endl
 
 			<<bodyContent;
-
-	_attached << _options->getTxt("attachedReportHeader") <<endl
-			<<"var subject = \"" <<_subject <<"\";" <<endl
-			<<"var version = " <<_options->getVersion() <<";" <<endl
-			<<"var arrNodes = [['Report', ['',,'folder'], [" <<endl
-
-			<<attachedContent <<endl
-
-			<<"]]];" <<endl
-			<< _options->getTxt("attachedReportFooter");
 }
 
 
 void Report::saveAttachedReport() {
+	_attached <<endl
+			<<"]]];" <<endl
+			<< _options->getTxt("attachedReportFooter");
 	try {
-		string date = DateTimeFormatter::format(Timestamp(), "%Y%m%d"),
-				iStr, dir(REPORT_DIR);
-		int i = 0, tempInt;
-		RegularExpression patt("^report_"
-				+ date + "_(\\d+)\\.(htm|zip)$", 0, true);
-		DirectoryIterator it(dir), end;
-		while (it != end) {
-			if (patt.match(it.name())) {
-				iStr = it.name();
-				patt.subst(iStr, "$1");
-				stringstream ss(iStr);
-				ss >> tempInt;
-				if (tempInt > i)
-					i = tempInt;
-			}
-			else
-				it->remove();
-			++it;
-		}
-		stringstream ss;
-		ss <<"report_" <<date <<"_" << ++i;
-		string fname(dir + ss.str() + ".htm");
-		ofstream htmFile(fname.c_str(), ios::out);
-		StreamCopier::copyStream(_attached, htmFile);
-		htmFile.close();
-		int fsize = File(fname).getSize();
-		if (_options->doCompressAttachedReport() || fsize > (10 * 1024 * 1024)) {
-			string zfname(dir + ss.str() + ".zip");
-			ofstream zipFile(zfname.c_str(), std::ios::binary);
-			Compress c(zipFile, true);
-			Path fullPath(fname), shortPath(ss.str() + ".htm");
-			if (fullPath.isFile()) {
-				c.addFile(fullPath, shortPath);
-				c.close();
-				zipFile.close();
-				_attachments.push_back(Path(zfname));
-			}
-		}
-		else
-			_attachments.push_back(Path(fname));
+		if (_attached.is_open())
+			_attachments.push_back(
+					_attached.finish(_options->doCompressAttachedReport()));
 	}
 	catch (Exception &exc) {
 		cout <<exc.displayText() <<endl;
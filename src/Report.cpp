@@ -30,6 +30,7 @@ string Report::name() const {
 void Report::generate() {
 	_contentType = "text/html";
 	string suspicious;
+	openAttachedReport();
 	makeBypassesSection();
 	makeWarningsSection(suspicious);
 	makeWhitelistSection();
@@ -93,13 +94,11 @@ void Report::makeWarningsSection(string &suspicious) {
 		map<string, vector<int> > tree;
 		stringstream urlsContent,
 			attUrlsContent;
-		vector<BlacklistKeyword> keywords;
 		while (warnings.hasMore()) {
-			keywords = warnings.getKeywords();
-			for(vector<BlacklistKeyword>::iterator it = keywords.begin();
-					it != keywords.end(); it++)
-			{
-				key = it->asString + " (" + it->category + ")";
+			const KeywordHits &keywords = warnings.getKeywords();
+			for (size_t i = 0; i < keywords.size(); i++) {
+				key = KeywordTable::lookup(keywords[i].keyword) + " ("
+						+ KeywordTable::lookup(keywords[i].category) + ")";
 				tree[key].push_back(warnings.getIndex());
 			}
 			warnings.next();
@@ -187,76 +186,93 @@ void Report::makeWhitelistSection() {
 
 
 void Report::makeHistorySection() {
+	if (!_options->doSaveHistory())
+		return;
 	bool doIncludePaths = _options->isAttachedReportPart("history_paths");
-
+
 	RegularExpression secondLevel("(^\\d+\\.\\d+\\.\\d+\\.\\d+"
 			"(:\\d*)?$)|(([^\\.]+\\.)([^\\.]+)$)", 0, true);
-	string s = "",
-		historyContent = "",
-		domainsContent,
-		pathsContent;
-	set<string> secondLevelDomains;
-
-	vector<string> hostnames = _db->getDistinctHostnames();
-	if (hostnames.size() > 0) {
+	string s = "";
+	set<string> secondLevelDomains;
+	map<string, vector<string> > domainHostnames;
+	HistoryPaths paths(this);
+
+	vector<string> hostnames;
+
+	/* the whole history in one query, instead of one per domain and
+	 * hostname */
+	if (doIncludePaths) {
+		_db->getHistory(paths, "hostname <> ''", "hostname, path");
+		paths.getHostnames(hostnames);
+	}
+	else
+		hostnames = _db->getDistinctHostnames();
+
+	/* the section is written to the report as it's made; only the branches
+	 * of the hostnames are set aside, in the file of paths */
+	_attached <<beginJavascriptBranch(jsContent(_options
+			->getTxt("reportHistoryTitle")));
+	if (hostnames.size() > 0) {
 		for (vector<string>::iterator it = hostnames.begin();
 				it != hostnames.end(); it++)
-		{
+		{
 			if (secondLevel.extract(*it, s, 0))
 				secondLevelDomains.insert(s);
 			else
 				secondLevelDomains.insert(*it);
 		}
-
+
+		groupByDomain(hostnames, secondLevelDomains, domainHostnames);
+
 		for(set<string>::iterator it = secondLevelDomains.begin();
 				it != secondLevelDomains.end(); it++)
-		{
-			domainsContent = "";
-			hostnames = _db->getDistinctHostnames("hostname LIKE '%"
-					+ *it + "'", "hostname");
+		{
+			_attached <<beginJavascriptBranch(jsContent(*it));
+			hostnames.swap(domainHostnames[*it]);
 			for (vector<string>::iterator it2 = hostnames.begin();
 					it2 != hostnames.end(); it2++)
-			{
-				if (doIncludePaths) {
-					pathsContent = "";
-
-					History history = _db->getHistory("hostname = '"
-							+ *it2 + "'", "path");
-					while (history.hasMore()) {
-						pathsContent += "['" + jsContent(history.getUrl())
-								+ "', ['http'],, '"
-								+ jsContent(history.getDateTime(
-										_options->getTxt("dateTimeFormat")))
-								+ "'],\n";
-						history.next();
-					}
-
+			{
+				if (doIncludePaths) {
 					if (*it == *it2 && hostnames.size() == 1)
-						domainsContent += pathsContent;
-					else
-						domainsContent += makeJavascriptBranch(*it2, pathsContent);
-				}
+						paths.copy(*it2, _attached);
+					else {
+						_attached <<beginJavascriptBranch(*it2);
+						paths.copy(*it2, _attached);
+						_attached <<endJavascriptBranch();
+					}
+				}
 				else
-					domainsContent += "['" + jsContent(*it2) + "', ['http',,'folder'],, ''],\n";
+					_attached <<"['" + jsContent(*it2) + "', ['http',,'folder'],, ''],\n";
 			}
-			historyContent += makeJavascriptBranch(jsContent(*it), domainsContent);
+			_attached <<endJavascriptBranch();
 		}
 	}
-	else
-		historyContent += "['" + jsContent(_options->getTxt("reportNoHistory"))
+	else
+		_attached <<"['" + jsContent(_options->getTxt("reportNoHistory"))
 				+ "', ['']]";
-	if (_options->doSaveHistory())
-		_attached <<makeJavascriptBranch(jsContent(_options
-				->getTxt("reportHistoryTitle")), historyContent);
-}
-
-
-
-void Report::addTemplate(string suspicious) {
-	string bodyContent = _body.str(),
-			attachedContent = _attached.str();
-	_body.str("");
-	_attached.str("");
+	_attached <<endJavascriptBranch();
+}
+
+
+
+void Report::openAttachedReport() {
+	try {
+		_attached.create(REPORT_DIR);
+	}
+	catch (Exception &exc) {
+		cout <<exc.displayText() <<endl;
+	}
+	_attached << _options->getTxt("attachedReportHeader") <<endl
+			<<"var subject = \"" <<_subject <<"\";" <<endl
+			<<"var version = \"" <<_options->getVersion() <<"\";" <<endl
+			<<"var arrNodes = [['Report', ['',,'folder'], [" <<endl;
+}
+
+
+
+void Report::addTemplate(string suspicious) {
+	string bodyContent = _body.str();
+	_body.str("");
 
 	_body <<"<a name='top'><h1>" <<_subject <<"</h1></a>" <<endl
 			<<_options->getTxt("reportGeneratedBy") <<"<br />" <<endl
@@ -267,69 +283,161 @@ void Report::addTemplate(string suspicious) {
 					+ suspicious : "") <<endl
 			<<"<hr />" <<endl
 
-			<<bodyContent;
+			<<bodyContent;
+}
+
+
+void Report::saveAttachedReport() {
+	_attached <<endl
+			<<"]]];" <<endl
+			<< _options->getTxt("attachedReportFooter");
+	try {
+		if (_attached.is_open())
+			_attachments.push_back(
+					_attached.finish(_options->doCompressAttachedReport()));
+	}
+	catch (Exception &exc) {
+		cout <<exc.displayText() <<endl;
+	}
+
+}
 
-	_attached << _options->getTxt("attachedReportHeader") <<endl
-			<<"var subject = \"" <<_subject <<"\";" <<endl
-			<<"var version = \"" <<_options->getVersion() <<"\";" <<endl
-			<<"var arrNodes = [['Report', ['',,'folder'], [" <<endl
 
-			<<attachedContent <<endl
 
-			<<"]]];" <<endl
-			<< _options->getTxt("attachedReportFooter");
+void Report::groupByDomain(const vector<string>& hostnames,
+		const set<string>& domains, map<string, vector<string> >& hosts)
+{
+	map<string, vector<string> > plain;
+	vector<string> wildcards;
+	string suffix;
+
+	/* a domain without wildcards matches the hostnames ending with it, so
+	 * each suffix of a hostname is looked up; LIKE ignores the case */
+	for (set<string>::const_iterator d = domains.begin(); d != domains.end(); d++) {
+		hosts[*d].clear();
+		if (d->find_first_of("%_") != string::npos)
+			wildcards.push_back(*d);
+		else {
+			suffix = *d;
+			for (size_t i = 0; i < suffix.length(); i++)
+				suffix[i] = tolower((unsigned char)suffix[i]);
+			plain[suffix].push_back(*d);
+		}
+	}
+
+	for (vector<string>::const_iterator h = hostnames.begin();
+			h != hostnames.end(); h++)
+	{
+		suffix = *h;
+		for (size_t i = 0; i < suffix.length(); i++)
+			suffix[i] = tolower((unsigned char)suffix[i]);
+		/* the empty suffix too, as LIKE '%' matches every hostname */
+		for (size_t i = 0; i <= suffix.length(); i++) {
+			map<string, vector<string> >::iterator p = plain.find(suffix.substr(i));
+			if (p == plain.end())
+				continue;
+			for (vector<string>::iterator d = p->second.begin();
+					d != p->second.end(); d++)
+			{
+				hosts[*d].push_back(*h);
+			}
+		}
+		for (vector<string>::iterator d = wildcards.begin();
+				d != wildcards.end(); d++)
+		{
+			if (isLike(h->c_str(), ("%" + *d).c_str()))
+				hosts[*d].push_back(*h);
+		}
+	}
 }
 
 
-void Report::saveAttachedReport() {
-	try {
-		string date = DateTimeFormatter::format(Timestamp(), "%Y%m%d"),
-				iStr, dir(REPORT_DIR);
-		int i = 0, tempInt;
-		RegularExpression patt("^report_"
-				+ date + "_(\\d+)\\.(htm|zip)$", 0, true);
-		if (!File(dir).exists())
-			File(dir).createDirectory();
-		DirectoryIterator it(dir), end;
-		while (it != end) {
-			if (patt.match(it.name())) {
-				iStr = it.name();
-				patt.subst(iStr, "$1");
-				stringstream ss(iStr);
-				ss >> tempInt;
-				if (tempInt > i)
-					i = tempInt;
+
+bool Report::isLike(const char* text, const char* pattern) {
+	for (; *pattern; pattern++) {
+		if (*pattern == '%') {
+			for (const char *t = text; ; t++) {
+				if (isLike(t, pattern + 1))
+					return true;
+				if (!*t)
+					return false;
 			}
-			else
-				it->remove();
-			++it;
 		}
-		stringstream ss;
-		ss <<"report_" <<date <<"_" << ++i;
-		string fname(dir + ss.str() + ".htm");
-		ofstream htmFile(fname.c_str(), ios::out);
-		StreamCopier::copyStream(_attached, htmFile);
-		htmFile.close();
-		int fsize = File(fname).getSize();
-		if (_options->doCompressAttachedReport() || fsize > (10 * 1024 * 1024)) {
-			string zfname(dir + ss.str() + ".zip");
-			ofstream zipFile(zfname.c_str(), std::ios::binary);
-			Compress c(zipFile, true);
-			Path fullPath(fname), shortPath(ss.str() + ".htm");
-			if (fullPath.isFile()) {
-				c.addFile(fullPath, shortPath);
-				c.close();
-				zipFile.close();
-				_attachments.push_back(Path(zfname));
-			}
+		if (!*text)
+			return false;
+		if (*pattern == '_') {
+			/* one whole UTF-8 character */
+			text++;
+			while ((*text & 0xC0) == 0x80)
+				text++;
+			continue;
 		}
-		else
-			_attachments.push_back(Path(fname));
+		if (tolower((unsigned char)*text) != tolower((unsigned char)*pattern))
+			return false;
+		text++;
+	}
+	return !*text;
+}
+
+
+
+Report::HistoryPaths::HistoryPaths(Report* report) {
+	_report = report;
+	_current = _ranges.end();
+	_size = 0;
+	_format = report->_options->getTxt("dateTimeFormat");
+	_hitsFormat = report->_options->getTxt("reportHits");
+	_stream.open(_file.path().c_str(),
+			ios::in | ios::out | ios::trunc | ios::binary);
+}
+
+
+
+void Report::HistoryPaths::handleRow(const HistoryRow& row) {
+	/* the rows come ordered by hostname, so each branch is in one piece */
+	if (_current == _ranges.end() || _current->first != row.hostname) {
+		_current = _ranges.insert(
+				make_pair(row.hostname, make_pair(_size, _size))).first;
 	}
-	catch (Exception &exc) {
-		cout <<exc.displayText() <<endl;
+	string time = DateTimeFormatter::format(row.dateTime, _format);
+	if (row.hits > 1 && !_hitsFormat.empty()) {
+		stringstream hits;
+		hits <<row.hits;
+		string txt = _hitsFormat;
+		_report->replaceVar(txt, "hits", hits.str());
+		_report->replaceVar(txt, "lastSeen",
+				DateTimeFormatter::format(row.lastSeen, _format));
+		time += " " + txt;
 	}
+	_row = "['" + _report->jsContent(row.hostname + row.path)
+			+ "', ['http'],, '" + _report->jsContent(time) + "'],\n";
+	_stream.write(_row.data(), _row.length());
+	_size += _row.length();
+	_current->second.second = _size;
+}
+
 
+
+void Report::HistoryPaths::getHostnames(vector<string>& hostnames) const {
+	for (Ranges::const_iterator r = _ranges.begin(); r != _ranges.end(); r++)
+		hostnames.push_back(r->first);
+}
+
+
+
+void Report::HistoryPaths::copy(const string& hostname, ostream& out) {
+	char buffer[8192];
+	Ranges::const_iterator r = _ranges.find(hostname);
+	if (r == _ranges.end())
+		return;
+	streamoff left = r->second.second - r->second.first;
+	_stream.seekg(r->second.first);
+	while (left > 0 && _stream.read(buffer,
+			left < (streamoff)sizeof(buffer) ? left : sizeof(buffer)))
+	{
+		out.write(buffer, _stream.gcount());
+		left -= _stream.gcount();
+	}
 }
 
 
@@ -387,5 +495,17 @@ string Report::makeTableBranch(string title, string content, string anchorName){
 
 
 string Report::makeJavascriptBranch(string title, string content) {
-	return "['" + title + "', ['',,'folder'], [\n" + content + "]],\n";
+	return beginJavascriptBranch(title) + content + endJavascriptBranch();
+}
+
+
+
+string Report::beginJavascriptBranch(string title) {
+	return "['" + title + "', ['',,'folder'], [\n";
+}
+
+
+
+string Report::endJavascriptBranch() {
+	return "]],\n";
 }
@@ -185,13 +185,11 @@ void ReportBase::sendImprovementData() {
 	if (_options->doSendImprovementData() && warnings.size() > 0) {
 		string impData = "";
 		stringstream strength;
-		vector<BlacklistKeyword> keywords;
 		while (warnings.hasMore()) {
-			keywords = warnings.getKeywords();
-			for(vector<BlacklistKeyword>::iterator it = keywords.begin();
-					it != keywords.end(); it++)
-			{
-				impData += it->category + "¤" + it->asString + "¤";
+			const KeywordHits &keywords = warnings.getKeywords();
+			for (size_t i = 0; i < keywords.size(); i++) {
+				impData += KeywordTable::lookup(keywords[i].category) + "¤"
+						+ KeywordTable::lookup(keywords[i].keyword) + "¤";
 				URI::encode(warnings.getBoldUrl(), "&'\"<>", impData);
 				impData += "¤";
 				URI::encode(warnings.getUrl(), "&'\"<>", impData);
@@ -200,7 +198,7 @@ void ReportBase::sendImprovementData() {
 				strength.str("");
 				strength <<"¤" <<warnings.getStrength();
 				impData += strength.str();
-				if (it + 1 != keywords.end())
+				if (i + 1 != keywords.size())
 					impData += "\n";
 			}
 			warnings.next();
@@ -54,8 +54,18 @@ void ReportSubsystem::initialize(Application& app) {
 					report->install();
 				else if (type == REPORT_UNINSTALL)
 					report->uninstall();
-				else
-					report->generate();
+				else {
+					Database &db = MainApplication::getDatabase();
+					db.beginSnapshot();
+					try {
+						report->generate();
+					}
+					catch (...) {
+						db.endSnapshot();
+						throw;
+					}
+					db.endSnapshot();
+				}
 
 				_logger->notice("Sending report");
 				int errorCode = report->send();
@@ -0,0 +1,312 @@
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <RingSnifferThread> captures packets through a memory-mapped TPACKET_V3 ring
+
+
+#include "RingSnifferThread.h"
+
+#if POCO_OS == POCO_OS_LINUX
+
+#include <errno.h>
+#include <string.h>
+
+
+
+RingSnifferThread::RingSnifferThread() : SnifferThread() {
+	unsigned int pageSize = getpagesize();
+	_socket = -1;
+	_isCooked = false;
+	_ring = 0;
+	_ringSize = 0;
+	_blockSize = _options->getCaptureRingBlockSize();
+	_blockSize = ((_blockSize + pageSize - 1) / pageSize) * pageSize;
+	if (_blockSize == 0)
+		_blockSize = pageSize;
+	_blockCount = _options->getCaptureRingBlocks();
+	if (_blockCount == 0)
+		_blockCount = 1;
+	_blockTimeout = _options->getCaptureRingTimeout();
+	_blocks = 0;
+	_frames = 0;
+	_maxFramesPerBlock = 0;
+	_retireLatencyTotal = 0;
+	_retireLatencyMax = 0;
+}
+
+
+
+RingSnifferThread::~RingSnifferThread() {
+	closeRing();
+}
+
+
+
+int RingSnifferThread::openDevice(string device) {
+	const unsigned int FRAME_SIZE = 2048;
+	int version = TPACKET_V3;
+	struct tpacket_req3 req;
+	struct sockaddr_ll addr;
+
+	/* "any" mixes links of every kind, so like pcap it's captured without
+	 * the link layer headers */
+	_isCooked = (device == "any");
+	if ((_socket = socket(AF_PACKET, _isCooked ? SOCK_DGRAM : SOCK_RAW,
+			htons(ETH_P_ALL))) == -1)
+	{
+		*_logStream <<"Error opening ring on " <<device <<": "
+				<<strerror(errno) <<endl;
+		return -1;
+	}
+
+	if (setsockopt(_socket, SOL_PACKET, PACKET_VERSION,
+			&version, sizeof(version)) == -1)
+	{
+		*_logStream <<"TPACKET_V3 is not supported on " <<device <<": "
+				<<strerror(errno) <<endl;
+		closeRing();
+		return -1;
+	}
+
+	if (attachFilter() == -1) {
+		closeRing();
+		return -1;
+	}
+
+	memset(&req, 0, sizeof(req));
+	req.tp_block_size = _blockSize;
+	req.tp_block_nr = _blockCount;
+	req.tp_frame_size = FRAME_SIZE;
+	req.tp_frame_nr = (_blockSize / FRAME_SIZE) * _blockCount;
+	req.tp_retire_blk_tov = _blockTimeout;
+	req.tp_feature_req_word = 0;
+	if (setsockopt(_socket, SOL_PACKET, PACKET_RX_RING,
+			&req, sizeof(req)) == -1)
+	{
+		*_logStream <<"Couldn't set up a ring of " <<_blockCount <<" x "
+				<<_blockSize <<" bytes on " <<device <<": "
+				<<strerror(errno) <<endl;
+		closeRing();
+		return -1;
+	}
+
+	_ringSize = (size_t)_blockSize * _blockCount;
+	_ring = (u_char*)mmap(0, _ringSize, PROT_READ | PROT_WRITE,
+			MAP_SHARED, _socket, 0);
+	if (_ring == MAP_FAILED) {
+		_ring = 0;
+		*_logStream <<"Couldn't map the ring on " <<device <<": "
+				<<strerror(errno) <<endl;
+		closeRing();
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sll_family = AF_PACKET;
+	addr.sll_protocol = htons(ETH_P_ALL);
+	addr.sll_ifindex = (device == "any" ? 0 : if_nametoindex(device.c_str()));
+	if (device != "any" && addr.sll_ifindex == 0) {
+		*_logStream <<"Error opening device " <<device <<": "
+				<<strerror(errno) <<endl;
+		closeRing();
+		return -1;
+	}
+	if (bind(_socket, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+		*_logStream <<"Couldn't bind the ring to " <<device <<": "
+				<<strerror(errno) <<endl;
+		closeRing();
+		return -1;
+	}
+
+	return 0;
+}
+
+
+
+int RingSnifferThread::attachFilter() {
+	struct bpf_program comp;
+	struct sock_fprog prog;
+	/* the kernel filters a cooked socket from the network header, which is
+	 * what pcap's "raw IP" link type starts with */
+	pcap_t *dead = pcap_open_dead(_isCooked ? DLT_RAW : DLT_EN10MB, 65535);
+	if (dead == NULL) {
+		*_logStream <<"Couldn't prepare sniffPattern " <<_sniffPattern <<endl;
+		return -1;
+	}
+
+	if (pcap_compile(dead, &comp, _sniffPattern, 1, PCAP_NETMASK_UNKNOWN) == -1) {
+		*_logStream <<"Couldn't parse sniffPattern " <<_sniffPattern
+				<<": " <<pcap_geterr(dead) <<endl;
+		pcap_close(dead);
+		return -1;
+	}
+
+	/* struct bpf_insn and struct sock_filter share the same layout */
+	prog.len = comp.bf_len;
+	prog.filter = (struct sock_filter*)comp.bf_insns;
+	int res = setsockopt(_socket, SOL_SOCKET, SO_ATTACH_FILTER,
+			&prog, sizeof(prog));
+	if (res == -1) {
+		*_logStream <<"Couldn't install sniffPattern " <<_sniffPattern
+				<<": " <<strerror(errno) <<endl;
+	}
+	pcap_freecode(&comp);
+	pcap_close(dead);
+	return res;
+}
+
+
+
+void RingSnifferThread::run() {
+	unsigned int current = 0;
+	struct pollfd pfd;
+	struct tpacket_block_desc *block;
+
+	memset(&pfd, 0, sizeof(pfd));
+	pfd.fd = _socket;
+	pfd.events = POLLIN | POLLERR;
+
+	while (_ring != 0 && !_isStopping) {
+		block = (struct tpacket_block_desc*)(_ring + (size_t)current * _blockSize);
+		if ((block->hdr.bh1.block_status & TP_STATUS_USER) == 0) {
+			if (poll(&pfd, 1, 1000) == -1 && errno != EINTR) {
+				*_logStream <<"Error reading the packets: "
+						<<strerror(errno) <<endl;
+				break;
+			}
+			continue;
+		}
+
+		walkBlock(block);
+
+		// Hand the block back to the kernel
+		__sync_synchronize();
+		block->hdr.bh1.block_status = TP_STATUS_KERNEL;
+		current = (current + 1) % _blockCount;
+
+		if (_isDebugging && _lastStats.isElapsed(60 * Timestamp::resolution()))
+			logStats();
+	}
+
+	closeRing();
+}
+
+
+
+void RingSnifferThread::walkBlock(struct tpacket_block_desc *block) {
+	struct pcap_pkthdr header;
+	struct tpacket3_hdr *frame;
+	unsigned int numFrames = block->hdr.bh1.num_pkts;
+
+	frame = (struct tpacket3_hdr*)((u_char*)block
+			+ block->hdr.bh1.offset_to_first_pkt);
+	for (unsigned int i = 0; i < numFrames; i++) {
+		header.ts.tv_sec = frame->tp_sec;
+		header.ts.tv_usec = frame->tp_nsec / 1000;
+		header.caplen = frame->tp_snaplen;
+		header.len = frame->tp_len;
+		if (_isCooked) {
+			/* the kernel leaves 16 bytes free in front of the network header
+			 * of a cooked frame; they stand in for the ethernet header that
+			 * processPacket() skips, and aren't read */
+			header.caplen += SIZE_ETHERNET;
+			header.len += SIZE_ETHERNET;
+			processPacket(&header,
+					(u_char*)frame + frame->tp_net - SIZE_ETHERNET);
+		}
+		else
+			processPacket(&header, (u_char*)frame + frame->tp_mac);
+		frame = (struct tpacket3_hdr*)((u_char*)frame + frame->tp_next_offset);
+	}
+
+	// The retire latency is measured from the first frame of the block until
+	// the block reached us, which covers both the retire timeout and any time
+	// the block spent waiting behind other blocks.
+	Timestamp first = Timestamp::fromEpochTime(block->hdr.bh1.ts_first_pkt.ts_sec)
+			+ block->hdr.bh1.ts_first_pkt.ts_nsec / 1000;
+	Timestamp::TimeDiff latency = first.elapsed();
+	if (latency < 0)
+		latency = 0;
+
+	_blocks++;
+	_frames += numFrames;
+	if (numFrames > _maxFramesPerBlock)
+		_maxFramesPerBlock = numFrames;
+	_retireLatencyTotal += latency;
+	if (latency > _retireLatencyMax)
+		_retireLatencyMax = latency;
+}
+
+
+
+void RingSnifferThread::logStats() {
+	*_logStream <<"Ring: " <<_blocks <<" blocks, " <<_frames <<" frames, "
+			<<getAverageFramesPerBlock() <<" frames/block (max "
+			<<_maxFramesPerBlock <<"), retire latency "
+			<<getAverageRetireLatency() <<" us (max "
+			<<_retireLatencyMax <<" us)" <<endl;
+	_lastStats.update();
+}
+
+
+
+void RingSnifferThread::closeRing() {
+	if (_ring != 0) {
+		munmap(_ring, _ringSize);
+		_ring = 0;
+	}
+	if (_socket != -1) {
+		close(_socket);
+		_socket = -1;
+	}
+}
+
+
+
+Poco::UInt64 RingSnifferThread::getBlockCount() const {
+	return _blocks;
+}
+
+
+
+Poco::UInt64 RingSnifferThread::getFrameCount() const {
+	return _frames;
+}
+
+
+
+unsigned int RingSnifferThread::getMaxFramesPerBlock() const {
+	return _maxFramesPerBlock;
+}
+
+
+
+double RingSnifferThread::getAverageFramesPerBlock() const {
+	return (_blocks > 0 ? (double)_frames / _blocks : 0);
+}
+
+
+
+Timestamp::TimeDiff RingSnifferThread::getAverageRetireLatency() const {
+	return (_blocks > 0 ? _retireLatencyTotal / (Timestamp::TimeDiff)_blocks : 0);
+}
+
+
+
+Timestamp::TimeDiff RingSnifferThread::getMaxRetireLatency() const {
+	return _retireLatencyMax;
+}
+
+#endif // POCO_OS_LINUX
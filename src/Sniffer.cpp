@@ -18,10 +18,12 @@
 
 
 #include "Sniffer.h"
+#include "RingSnifferThread.h"
 
 
 
 Sniffer* Sniffer::_instance = 0;
+std::atomic<bool> Sniffer::_isStopRequested(false);
 
 
 
@@ -31,27 +33,174 @@ Sniffer::Sniffer() {
 	_logStream->warning();
 	_db = &MainApplication::getDatabase();
 	_filter = new Filter(&MainApplication::getOptions(), _db);
+	_filterGeneration = 0;
+	_writer = NULL;
+	_loader = NULL;
+}
+
+
+
+Sniffer::~Sniffer() {
+	_instance = 0;
 }
 
 
 
 void Sniffer::run() {
+	Options &options = MainApplication::getOptions();
 	vector<string> devs = getDevices();
-	vector<SnifferThread*> threads;
+	int numWorkers = options.getFilterWorkers();
+	if (numWorkers < 1)
+		numWorkers = 1;
+
+	for (int i = 0; i < numWorkers; i++)
+		_workers.push_back(new FilterWorker(i));
+
 	for (vector<string>::iterator it = devs.begin(); it != devs.end(); it++) {
-		threads.push_back(new SnifferThread());
-		if (threads.back()->openDevice(*it) == -1)
-			threads.pop_back();
-		else
-			Poco::ThreadPool::defaultPool().start(*(threads.back()));
+		_snifferThreads.push_back(createThread());
+		if (_snifferThreads.back()->openDevice(*it) == -1) {
+			delete _snifferThreads.back();
+			_snifferThreads.pop_back();
+			continue;
+		}
+		for (vector<FilterWorker*>::iterator w = _workers.begin();
+				w != _workers.end(); w++)
+		{
+			_rings.push_back(new UrlRing(options.getFilterRingSize()));
+			_snifferThreads.back()->addRing(_rings.back());
+			(*w)->addRing(_rings.back());
+		}
+	}
+
+	_writer = new DatabaseWriter(_db, options.getDbQueueSize(),
+			options.getDbQueuePolicy() == "block",
+			options.getDbBatchInterval(), options.getDbCoalesceWindow(),
+			options.getDbVacuumHour());
+
+	_loader = new FilterLoader(&options, options.getBlacklistCheckInterval());
+
+	/* every part gets a thread of its own, so stop() can wait for each of
+	 * them in turn */
+	_writerThread.start(*_writer);
+	_loaderThread.start(*_loader);
+	for (vector<FilterWorker*>::iterator w = _workers.begin();
+			w != _workers.end(); w++)
+	{
+		_workerThreads.push_back(new Poco::Thread());
+		_workerThreads.back()->start(**w);
+	}
+	for (vector<SnifferThread*>::iterator t = _snifferThreads.begin();
+			t != _snifferThreads.end(); t++)
+	{
+		_captureThreads.push_back(new Poco::Thread());
+		_captureThreads.back()->start(**t);
+	}
+
+	/* the signal handler only asks for the stop, it's done from here */
+	while (!_isStopRequested && isCapturing())
+		Poco::Thread::sleep(SNIFFER_STOP_POLL);
+	stop();
+
+	for (size_t i = 0; i < _captureThreads.size(); i++) {
+		delete _captureThreads[i];
+		delete _snifferThreads[i];
+	}
+	for (size_t i = 0; i < _workerThreads.size(); i++) {
+		delete _workerThreads[i];
+		delete _workers[i];
 	}
-	Poco::ThreadPool::defaultPool().joinAll();
+	for (vector<UrlRing*>::iterator r = _rings.begin(); r != _rings.end(); r++)
+		delete *r;
+	_captureThreads.clear();
+	_snifferThreads.clear();
+	_workerThreads.clear();
+	_workers.clear();
+	_rings.clear();
+	delete _loader;
+	delete _writer;
+	_loader = NULL;
+	_writer = NULL;
 }
 
 
 
-Filter& Sniffer::getFilter() {
-	return *_instance->_filter;
+bool Sniffer::requestStop() {
+	_isStopRequested = true;
+	return _instance != NULL;
+}
+
+
+
+bool Sniffer::isCapturing() const {
+	for (vector<Poco::Thread*>::const_iterator t = _captureThreads.begin();
+			t != _captureThreads.end(); t++)
+	{
+		if ((*t)->isRunning())
+			return true;
+	}
+	return false;
+}
+
+
+
+void Sniffer::stop() {
+	/* nothing may be logged once the writer has stopped, so everything
+	 * feeding it goes first: the capture, then the workers, which empty
+	 * their rings before they return */
+	for (vector<SnifferThread*>::iterator t = _snifferThreads.begin();
+			t != _snifferThreads.end(); t++)
+	{
+		(*t)->stop();
+	}
+	for (vector<Poco::Thread*>::iterator t = _captureThreads.begin();
+			t != _captureThreads.end(); t++)
+	{
+		(*t)->join();
+	}
+
+	_loader->stop();
+	for (vector<FilterWorker*>::iterator w = _workers.begin();
+			w != _workers.end(); w++)
+	{
+		(*w)->stop();
+	}
+	_loaderThread.join();
+	for (vector<Poco::Thread*>::iterator t = _workerThreads.begin();
+			t != _workerThreads.end(); t++)
+	{
+		(*t)->join();
+	}
+
+	/* the Database is deleted once we return, so the writer is waited for
+	 * however long it takes */
+	if (!_writer->stop())
+		*_logStream <<"Still writing to the database, waiting for it" <<endl;
+	_writerThread.join();
+}
+
+
+
+SharedPtr<Filter> Sniffer::getFilter() {
+	Poco::FastMutex::ScopedLock lock(_instance->_filterMutex);
+	return _instance->_filter;
+}
+
+
+
+Poco::UInt32 Sniffer::getFilterGeneration() {
+	return _instance->_filterGeneration.load(std::memory_order_acquire);
+}
+
+
+
+void Sniffer::publishFilter(SharedPtr<Filter> filter) {
+	{
+		Poco::FastMutex::ScopedLock lock(_instance->_filterMutex);
+		_instance->_filter.swap(filter);
+	}
+	_instance->_filterGeneration.fetch_add(1, std::memory_order_release);
+	/* filter now holds the old Filter; the workers still using it keep it
+	 * alive until they pick up the new one */
 }
 
 
@@ -62,14 +211,27 @@ LogStream& Sniffer::getLogStream() {
 
 
 
-void Sniffer::logUrl(HTTPRequest& request) {
-	_instance->_db->logUrl(request);
+void Sniffer::logRequest(const HttpRequestView& request, Poco::Int64 time,
+		bool isMatch, BlacklistMatch& match)
+{
+	_instance->_writer->log(request, time, isMatch, match);
 }
 
 
 
-void Sniffer::logWarning(BlacklistMatch match) {
-	_instance->_db->logWarning(match);
+SnifferThread* Sniffer::createThread() {
+	string backend = MainApplication::getOptions().getCaptureBackend();
+	if (backend == "ring") {
+#if POCO_OS == POCO_OS_LINUX
+		return new RingSnifferThread();
+#else
+		*_logStream <<"The ring capture backend needs Linux, using pcap" <<endl;
+#endif
+	}
+	else if (backend != "pcap")
+		*_logStream <<"Unknown capture backend " <<backend
+				<<", using pcap" <<endl;
+	return new SnifferThread();
 }
 
 
@@ -37,6 +37,7 @@ void SnifferSubsystem::initialize(Application& app) {
 
 		Sniffer sniffer;
 		sniffer.run();
+		File(MainApplication::getOptions().getPidfile()).remove();
 	}
 
 }
@@ -65,6 +66,8 @@ bool SnifferSubsystem::isOnlyInstance() {
 	}
 	MainApplication::getDatabase().logSessionStart();
 #endif
+	MainApplication::getDatabase().convertAutoVacuum();
+	MainApplication::getDatabase().resumeRotation();
 	ofstream f(pidfile.c_str(), ios::out);
 	f << currentPid;
 	f.close();
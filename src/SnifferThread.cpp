@@ -23,11 +23,27 @@
 
 
 
-SnifferThread::SnifferThread() {
+SnifferThread::SnifferThread()
+	: _reassembler(MainApplication::getOptions().getReassemblyFlows(),
+			MainApplication::getOptions().getReassemblyTimeout())
+{
 	_logStream = &Sniffer::getLogStream();
 	_options = &MainApplication::getOptions();
-	_filter = &Sniffer::getFilter();
-	_sniffPattern = (char*)"tcp[20:4] = 0x47455420 or tcp[32:4] = 0x47455420";
+	/* a GET at the start of the payload (with or without TCP options), or
+	 * any payload to port 80, where the rest of a split request comes from */
+	_sniffPattern = (char*)"tcp[20:4] = 0x47455420 or tcp[32:4] = 0x47455420"
+			" or (tcp dst port 80"
+			" and (ip[2:2] - ((ip[0] & 0xf) << 2) - ((tcp[12] & 0xf0) >> 2)) != 0)";
+	_isDebugging = Application::instance().config().getBool("debug", false);
+	_isStopping = false;
+	_fp = NULL;
+}
+
+
+
+SnifferThread::~SnifferThread() {
+	if (_fp != NULL)
+		pcap_close(_fp);
 }
 
 
@@ -73,37 +89,16 @@ int SnifferThread::openDevice(string device) {
 
 
 void SnifferThread::run() {
-	int res,
-		urlId;
+	int res = 0;
 	struct pcap_pkthdr *header;
 	const u_char *pkt_data;
-	BlacklistMatch match;
-	HTTPRequest request;
-	request.setChunkedTransferEncoding(true);
-	bool isMatch,
-		isDebugging = Application::instance().config().getBool("debug", false);
-
-	while((res = pcap_next_ex( _fp, &header, &pkt_data)) >= 0) {
-		try {
-			if (res == 0)
-				continue;
-
-			gotPacket(header, pkt_data, request);
-			if (request.empty())
-				throw Poco::Exception("No message found");
-
-			isMatch = _filter->isMatch(request, match);
-			Sniffer::logUrl(request);
-			if (isMatch)
-				Sniffer::logWarning(match);
-
-			if (isDebugging)
-				*_logStream <<isMatch <<endl;
-		}
-		catch (Poco::Exception &err) {
-			if (isDebugging)
-				*_logStream <<'-' <<endl;
-		}
+
+	while(!_isStopping
+			&& (res = pcap_next_ex( _fp, &header, &pkt_data)) >= 0)
+	{
+		if (res == 0)
+			continue;
+		processPacket(header, pkt_data);
 	}
 
 	if(res == -1) {
@@ -111,58 +106,126 @@ void SnifferThread::run() {
 		return;
 	}
 
-	pcap_close(_fp);
+	/* the handle is closed by the destructor, stop() may still use it */
 	return;
 }
 
 
+void SnifferThread::stop() {
+	_isStopping = true;
+	/* pcap_next_ex() returns on the read timeout anyway, this is only
+	 * quicker */
+	if (_fp != NULL)
+		pcap_breakloop(_fp);
+}
+
+
+
+void SnifferThread::addRing(UrlRing* ring) {
+	_rings.push_back(ring);
+}
+
+
+
+void SnifferThread::processPacket(const struct pcap_pkthdr *header,
+		const u_char *packet)
+{
+	gotPacket(header, packet, _request);
+	if (_isDebugging
+			&& _lastReassemblyStats.isElapsed(60 * Timestamp::resolution()))
+		logReassemblyStats();
+	if (_request.empty() || _rings.empty()) {
+		if (_isDebugging)
+			*_logStream <<'-' <<endl;
+		return;
+	}
+
+	string_view host = _request.host;
+	unsigned int hash = 2166136261u;
+	for (string_view::const_iterator it = host.begin(); it != host.end(); it++)
+		hash = (hash ^ (unsigned char)*it) * 16777619u;
+
+	_record.set(host, _request.target, header->ts.tv_sec);
+	if (_record.longUri != NULL && _isDebugging)
+		*_logStream <<"Long URI, " <<_record.longUri->length() <<" bytes, at "
+				<<host <<endl;
+	if (!_rings[hash % _rings.size()]->tryPush(_record)) {
+		delete _record.longUri;
+		if (_isDebugging)
+			*_logStream <<"Filter ring full, dropped " <<host <<endl;
+	}
+}
+
+
+
 void SnifferThread::gotPacket(const struct pcap_pkthdr *header,
-		const u_char *packet, HTTPRequest& request)
+		const u_char *packet, HttpRequestView& request)
 {
 	request.clear();
 	/* declare pointers to packet headers */
-	const struct sniff_ethernet *ethernet;  /* The ethernet header [1] */
 	const struct sniff_ip *ip;              /* The IP header */
 	const struct sniff_tcp *tcp;            /* The TCP header */
-	const char *payload;                    /* Packet payload */
+	const char *payload,                    /* Packet payload */
+		*head;                              /* Complete request head */
 
 	int size_ip,
 		size_tcp,
+		size_headers,
 		size_payload;
-
-	/* define ethernet header */
-	ethernet = (struct sniff_ethernet*)(packet);
+	size_t size_head;
+	FlowKey key;
 
 	/* define/compute ip header offset */
+	if (header->caplen < SIZE_ETHERNET + 20)
+		return;
 	ip = (struct sniff_ip*)(packet + SIZE_ETHERNET);
 	size_ip = IP_HL(ip) * 4;
-	if (size_ip < 20) {
-		return;
-	}
-	if (ip->ip_p == IPPROTO_IP) {
-		size_tcp = SIZE_TCP; //Correct number? Always constant?
-	}
-	else if (ip->ip_p == IPPROTO_TCP) {
-		/* define/compute tcp header offset */
-		tcp = (struct sniff_tcp*)(packet + SIZE_ETHERNET + size_ip);
-		size_tcp = TH_OFF(tcp)*4;
-		if (size_tcp < 20)
-			size_tcp = SIZE_TCP;
-	}
-	else
+	if (size_ip < 20 || ip->ip_p != IPPROTO_TCP)
 		return;
 
-	/* define/compute tcp payload (segment) offset */
-	try {
-		payload = (const char*)(packet + SIZE_ETHERNET + size_ip + size_tcp);
-		if (*payload != 'G')		//Try alternative SIZE_TCP = 10
-			payload = (const char*)(packet + SIZE_ETHERNET + size_ip + 10);
+	/* define/compute tcp header offset */
+	if ((int)header->caplen < SIZE_ETHERNET + size_ip + 20)
+		return;
+	tcp = (struct sniff_tcp*)(packet + SIZE_ETHERNET + size_ip);
+	size_tcp = TH_OFF(tcp)*4;
+	if (size_tcp < 20)
+		return;
 
-		istringstream istr(payload);
-		request.read(istr);
-	}
-	catch (Poco::Exception &err) {
-		request.clear();
+	/* define/compute tcp payload (segment) offset and size. The payload
+	 * ends with the IP datagram, not with any ethernet padding, and never
+	 * beyond what was actually captured. Segments offloaded to the NIC may
+	 * be captured with a total length of 0. */
+	size_headers = SIZE_ETHERNET + size_ip + size_tcp;
+	size_payload = header->caplen - size_headers;
+	if (ntohs(ip->ip_len) != 0
+			&& ntohs(ip->ip_len) - size_ip - size_tcp < size_payload)
+		size_payload = ntohs(ip->ip_len) - size_ip - size_tcp;
+	payload = (const char*)(packet + size_headers);
+
+	key.src = ip->ip_src.s_addr;
+	key.dst = ip->ip_dst.s_addr;
+	key.sport = tcp->th_sport;
+	key.dport = tcp->th_dport;
+
+	if (size_payload > 0 && _reassembler.add(key, ntohl(tcp->th_seq),
+			payload, size_payload, header->ts.tv_sec, head, size_head))
+	{
+		HttpParser::parse(head, size_head, request);
 	}
+	if (tcp->th_flags & (TH_FIN | TH_RST))
+		_reassembler.remove(key);
 	return;
 }
+
+
+
+void SnifferThread::logReassemblyStats() {
+	*_logStream <<"Reassembly: " <<_reassembler.getActive() <<"/"
+			<<_reassembler.getCapacity() <<" flows, "
+			<<_reassembler.getReassembled() <<" reassembled, "
+			<<_reassembler.getEvictions() <<" evicted, "
+			<<_reassembler.getExpirations() <<" expired, "
+			<<_reassembler.getOverflows() <<" overflowed, "
+			<<_reassembler.getGaps() <<" with gaps" <<endl;
+	_lastReassemblyStats.update();
+}
@@ -0,0 +1,270 @@
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <StreamReassembler> puts together HTTP request heads split over TCP segments
+
+
+#include "StreamReassembler.h"
+
+
+
+StreamReassembler::StreamReassembler(int flows, int timeout) {
+	unsigned int buckets = 2;
+	if (flows < 0)
+		flows = 0;
+	while (buckets < (unsigned int)flows * 2)
+		buckets <<= 1;
+
+	_flows.resize(flows);
+	_buckets.assign(buckets, -1);
+	_bucketMask = buckets - 1;
+	_timeout = timeout;
+	_lruHead = _lruTail = -1;
+	_active = 0;
+	_lastExpire = 0;
+	_reassembled = _evictions = _expirations = _overflows = _gaps = 0;
+
+	/* chain every flow into the free list */
+	_free = (flows > 0 ? 0 : -1);
+	for (int i = 0; i < flows; i++)
+		_flows[i].hashNext = (i + 1 < flows ? i + 1 : -1);
+}
+
+
+
+bool StreamReassembler::add(const FlowKey& key, Poco::UInt32 seq,
+		const char* payload, size_t length, Poco::Int64 now,
+		const char*& head, size_t& headLength)
+{
+	const char *end;
+	int index,
+		from;
+	size_t room;
+	Poco::UInt32 skip;
+
+	if (now - _lastExpire >= 1) {
+		expire(now);
+		_lastExpire = now;
+	}
+
+	index = (_flows.empty() ? -1 : find(key));
+	if (index >= 0) {
+		Flow &flow = _flows[index];
+		/* drop what we already have of a retransmitted segment */
+		skip = flow.nextSeq - seq;
+		if (skip != 0) {
+			if ((Poco::Int32)skip < 0) {
+				_gaps++;
+				release(index);
+				return false;
+			}
+			if (skip >= length)
+				return false;
+			payload += skip;
+			length -= skip;
+		}
+
+		room = REASSEMBLY_HEAD_LEN - flow.length;
+		if (length > room)
+			length = room;
+		memcpy(flow.data + flow.length, payload, length);
+		from = (flow.length > 3 ? flow.length - 3 : 0);
+		flow.length += length;
+		flow.nextSeq += length;
+		touch(index, now);
+
+		end = HttpParser::findHeadEnd(flow.data + from, flow.length - from);
+		if (end == 0 && flow.length < REASSEMBLY_HEAD_LEN)
+			return false;
+		if (end == 0)
+			_overflows++;
+		head = flow.data;
+		headLength = (end != 0 ? end - flow.data : flow.length);
+		_reassembled++;
+		/* the buffer stays untouched until the next call */
+		release(index);
+		return true;
+	}
+
+	/* only the segment carrying the request line opens a flow */
+	if (HttpParser::methodLength(payload, length) == 0)
+		return false;
+
+	end = HttpParser::findHeadEnd(payload, length);
+	if (end != 0 || length >= REASSEMBLY_HEAD_LEN || _flows.empty()) {
+		if (end == 0 && !_flows.empty())
+			_overflows++;
+		head = payload;
+		headLength = (end != 0 ? end - payload : length);
+		return true;
+	}
+
+	index = allocate(key, now);
+	Flow &flow = _flows[index];
+	memcpy(flow.data, payload, length);
+	flow.length = length;
+	flow.nextSeq = seq + length;
+	return false;
+}
+
+
+
+void StreamReassembler::remove(const FlowKey& key) {
+	int index = (_flows.empty() ? -1 : find(key));
+	if (index >= 0)
+		release(index);
+}
+
+
+
+void StreamReassembler::expire(Poco::Int64 now) {
+	while (_lruTail >= 0 && _flows[_lruTail].lastSeen + _timeout < now) {
+		release(_lruTail);
+		_expirations++;
+	}
+}
+
+
+
+int StreamReassembler::getActive() const {
+	return _active;
+}
+
+
+
+int StreamReassembler::getCapacity() const {
+	return _flows.size();
+}
+
+
+
+Poco::UInt64 StreamReassembler::getReassembled() const {
+	return _reassembled;
+}
+
+
+
+Poco::UInt64 StreamReassembler::getEvictions() const {
+	return _evictions;
+}
+
+
+
+Poco::UInt64 StreamReassembler::getExpirations() const {
+	return _expirations;
+}
+
+
+
+Poco::UInt64 StreamReassembler::getOverflows() const {
+	return _overflows;
+}
+
+
+
+Poco::UInt64 StreamReassembler::getGaps() const {
+	return _gaps;
+}
+
+
+
+unsigned int StreamReassembler::hash(const FlowKey& key) const {
+	unsigned int h = key.src * 2654435761u;
+	h ^= key.dst * 2246822519u;
+	h ^= (((unsigned int)key.sport << 16) | key.dport) * 3266489917u;
+	return (h ^ (h >> 15)) & _bucketMask;
+}
+
+
+
+int StreamReassembler::find(const FlowKey& key) const {
+	for (int i = _buckets[hash(key)]; i >= 0; i = _flows[i].hashNext) {
+		if (_flows[i].key == key)
+			return i;
+	}
+	return -1;
+}
+
+
+
+int StreamReassembler::allocate(const FlowKey& key, Poco::Int64 now) {
+	int index;
+	unsigned int bucket;
+
+	if (_free < 0) {
+		release(_lruTail);
+		_evictions++;
+	}
+	index = _free;
+	_free = _flows[index].hashNext;
+
+	bucket = hash(key);
+	_flows[index].key = key;
+	_flows[index].hashNext = _buckets[bucket];
+	_buckets[bucket] = index;
+	_flows[index].lruPrev = _flows[index].lruNext = -1;
+	_flows[index].length = 0;
+	touch(index, now);
+	_active++;
+	return index;
+}
+
+
+
+void StreamReassembler::release(int index) {
+	unsigned int bucket = hash(_flows[index].key);
+	int *link = &_buckets[bucket];
+	while (*link != index)
+		link = &_flows[*link].hashNext;
+	*link = _flows[index].hashNext;
+
+	unlinkLru(index);
+	_flows[index].hashNext = _free;
+	_free = index;
+	_active--;
+}
+
+
+
+void StreamReassembler::touch(int index, Poco::Int64 now) {
+	Flow &flow = _flows[index];
+	flow.lastSeen = now;
+	if (_lruHead == index)
+		return;
+	if (flow.lruPrev >= 0 || _lruTail == index)
+		unlinkLru(index);
+	flow.lruPrev = -1;
+	flow.lruNext = _lruHead;
+	if (_lruHead >= 0)
+		_flows[_lruHead].lruPrev = index;
+	_lruHead = index;
+	if (_lruTail < 0)
+		_lruTail = index;
+}
+
+
+
+void StreamReassembler::unlinkLru(int index) {
+	Flow &flow = _flows[index];
+	if (flow.lruPrev >= 0)
+		_flows[flow.lruPrev].lruNext = flow.lruNext;
+	else if (_lruHead == index)
+		_lruHead = flow.lruNext;
+	if (flow.lruNext >= 0)
+		_flows[flow.lruNext].lruPrev = flow.lruPrev;
+	else if (_lruTail == index)
+		_lruTail = flow.lruPrev;
+	flow.lruPrev = flow.lruNext = -1;
+}
@@ -0,0 +1,87 @@
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <UrlCoalescer> collapses repeated visits of a URL into one row
+
+
+#include "UrlCoalescer.h"
+
+
+
+UrlCoalescer::UrlCoalescer(int window) {
+	_window = window;
+	_first = 0;
+}
+
+
+
+bool UrlCoalescer::add(const string& hostname, const string& path,
+		Poco::Int64 time)
+{
+	if (_window <= 0)
+		return false;
+
+	/* a hostname never has a space, so the key can't be ambiguous */
+	_key.assign(hostname);
+	_key += ' ';
+	_key += path;
+	unordered_map<string, Poco::UInt64>::const_iterator it = _seq.find(_key);
+	if (it != _seq.end()) {
+		CoalescedUrl &url = _urls[it->second - _first];
+		url.hits++;
+		if (time > url.lastSeen)
+			url.lastSeen = time;
+		return true;
+	}
+
+	_seq[_key] = _first + _urls.size();
+	_urls.push_back(CoalescedUrl());
+	CoalescedUrl &url = _urls.back();
+	url.hostname = hostname;
+	url.path = path;
+	url.time = url.lastSeen = time;
+	url.hits = 1;
+	return true;
+}
+
+
+
+bool UrlCoalescer::pop(CoalescedUrl& url, Poco::Int64 now, bool all) {
+	if (_urls.empty())
+		return false;
+	CoalescedUrl &oldest = _urls.front();
+	if (!all && now - oldest.time < _window
+			&& _urls.size() <= URL_COALESCER_MAX_URLS)
+		return false;
+
+	_key.assign(oldest.hostname);
+	_key += ' ';
+	_key += oldest.path;
+	_seq.erase(_key);
+	url.hostname.swap(oldest.hostname);
+	url.path.swap(oldest.path);
+	url.time = oldest.time;
+	url.lastSeen = oldest.lastSeen;
+	url.hits = oldest.hits;
+	_urls.pop_front();
+	_first++;
+	return true;
+}
+
+
+
+size_t UrlCoalescer::size() const {
+	return _urls.size();
+}
@@ -88,12 +88,12 @@ string Warnings::getAbbrUrl(int index) const {
 
 
 
-vector<BlacklistKeyword> Warnings::getKeywords() const {
+const KeywordHits& Warnings::getKeywords() const {
 	return getKeywords(_index);
 }
 
 
 
-vector<BlacklistKeyword> Warnings::getKeywords(int index) const {
+const KeywordHits& Warnings::getKeywords(int index) const {
 	return _blacklistMatches[index].keyword;
 }
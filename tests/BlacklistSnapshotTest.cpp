@@ -0,0 +1,262 @@
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <BlacklistSnapshotTest> checks that a snapshot gives back the blacklist
+// MyXml parsed, and that a snapshot which doesn't check out is ignored.
+//
+// Usage: blacklistsnapshot-test <blacklist file>
+
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "Poco/File.h"
+#include "Poco/Path.h"
+#include "Poco/Process.h"
+#include "Poco/Timestamp.h"
+#include "Poco/Util/Application.h"
+
+#include "BlacklistSnapshot.h"
+#include "MyXml.h"
+
+using Poco::File;
+using Poco::Timestamp;
+using namespace std;
+
+
+
+class BlacklistSnapshotTest
+	/// Works on a copy of the blacklist in the temporary directory, so the
+	/// snapshot is written there. The copy is parsed with MyXml, saved and
+	/// read back, and then changed or damaged in the ways read() must notice,
+	/// after which the blacklist has to come from the XML again.
+{
+	public:
+		BlacklistSnapshotTest(const string& blacklistFile) {
+			stringstream path;
+			path <<Poco::Path::temp() <<"blacklist-snapshot-test-"
+					<<Poco::Process::id() <<".xml";
+			_xmlPath = path.str();
+			_failures = 0;
+			removeFiles();
+			File(blacklistFile).copyTo(_xmlPath);
+		}
+
+		~BlacklistSnapshotTest() {
+			removeFiles();
+		}
+
+		void testReadBack() {
+			Blacklist blacklist;
+			Extensions extensions;
+			Timestamp parsing;
+			parse();
+			Timestamp::TimeDiff parsed = parsing.elapsed();
+
+			check(!BlacklistSnapshot::read(_xmlPath, blacklist, extensions),
+					"there's no snapshot before one is written");
+			Timestamp writing;
+			check(BlacklistSnapshot::write(_xmlPath, _blacklist, _extensions),
+					"the snapshot is written");
+			Timestamp::TimeDiff written = writing.elapsed();
+			check(!File(BlacklistSnapshot::getPath(_xmlPath) + ".tmp").exists(),
+					"the temporary file is renamed");
+
+			Timestamp reading;
+			bool isRead = BlacklistSnapshot::read(_xmlPath, blacklist, extensions);
+			Timestamp::TimeDiff read = reading.elapsed();
+			check(isRead, "the snapshot is read");
+			compare(blacklist, extensions);
+
+			cout <<"XML parsed in " <<parsed / 1000 <<" ms, snapshot written in "
+					<<written / 1000 <<" ms and read in " <<read / 1000 <<" ms"
+					<<endl;
+		}
+
+		void testChangedXml() {
+			ofstream xml(_xmlPath.c_str(), ios::app);
+			xml <<"<!-- changed -->" <<endl;
+			xml.close();
+			checkIgnored("a snapshot of the XML as it was");
+		}
+
+		void testCorruptPayload() {
+			flipByte(BLACKLIST_SNAPSHOT_HEADER_LEN + 5);
+			checkIgnored("a snapshot with a corrupt payload");
+		}
+
+		void testTruncated() {
+			string path = BlacklistSnapshot::getPath(_xmlPath),
+				data;
+			readFile(path, data);
+			ofstream out(path.c_str(), ios::binary | ios::trunc);
+			out.write(data.data(), data.length() - 1);
+			out.close();
+			checkIgnored("a truncated snapshot");
+		}
+
+		void testVersion() {
+			/* the version follows the magic */
+			flipByte(4);
+			checkIgnored("a snapshot of another version");
+		}
+
+		int getFailures() const {
+			return _failures;
+		}
+
+	private:
+		void parse() {
+			AutoPtr<MyXml> xml (new MyXml(_xmlPath));
+			_blacklist = xml->getBlacklist();
+			_extensions = xml->getExtensions();
+		}
+
+		void checkIgnored(const string& what)
+			/// Check that read() turns the snapshot down and leaves the
+			/// blacklist alone, and that a new snapshot of the XML, written
+			/// as Filter does then, is read instead.
+		{
+			Blacklist blacklist(1);
+			Extensions extensions;
+			blacklist[0].name = "Untouched";
+			check(!BlacklistSnapshot::read(_xmlPath, blacklist, extensions),
+					what + " is ignored");
+			check(blacklist.size() == 1 && blacklist[0].name == "Untouched"
+					&& extensions.empty(), what + " leaves the blacklist alone");
+
+			parse();
+			check(BlacklistSnapshot::write(_xmlPath, _blacklist, _extensions),
+					what + " is replaced");
+			check(BlacklistSnapshot::read(_xmlPath, blacklist, extensions),
+					"the snapshot replacing " + what + " is read");
+			compare(blacklist, extensions);
+		}
+
+		void compare(const Blacklist& blacklist, const Extensions& extensions) {
+			if (blacklist.size() != _blacklist.size()) {
+				check(false, "the number of categories differs");
+				return;
+			}
+			for (size_t c = 0; c < blacklist.size(); c++) {
+				const BlacklistCategory &a = blacklist[c],
+					&b = _blacklist[c];
+				check(a.name == b.name, "category " + b.name + " is read back");
+				if (a.keyword.size() != b.keyword.size()) {
+					check(false, "the keywords of " + b.name + " are read back");
+					continue;
+				}
+				for (size_t k = 0; k < a.keyword.size(); k++)
+					compare(a.keyword[k], b.keyword[k]);
+			}
+
+			if (extensions.size() != _extensions.size()) {
+				check(false, "the number of extensions differs");
+				return;
+			}
+			for (size_t e = 0; e < extensions.size(); e++) {
+				check(extensions[e].strength == _extensions[e].strength
+						&& extensions[e].group == _extensions[e].group
+						&& extensions[e].pattern == _extensions[e].pattern
+						&& !extensions[e].re.isNull(),
+						"extension " + _extensions[e].pattern + " is read back");
+			}
+		}
+
+		void compare(const BlacklistKeyword& a, const BlacklistKeyword& b) {
+			RegularExpression::Match m;
+			check(a.strength == b.strength && a.asString == b.asString
+					&& a.pattern == b.pattern && a.literal == b.literal
+					&& a.re.size() == b.re.size(),
+					"keyword " + b.asString + " is read back");
+			for (size_t r = 0; r < a.re.size() && r < b.re.size(); r++) {
+				check(!a.re[r].isNull(), "keyword " + b.asString + " is compiled");
+				if (a.re[r].isNull())
+					continue;
+				/* the expression must match its own keyword the same way */
+				check(a.re[r]->match(b.asString, m) == b.re[r]->match(b.asString, m),
+						"keyword " + b.asString + " is compiled the same way");
+			}
+		}
+
+		void flipByte(size_t offset) {
+			string path = BlacklistSnapshot::getPath(_xmlPath),
+				data;
+			readFile(path, data);
+			if (offset >= data.length()) {
+				check(false, "the snapshot is long enough to damage");
+				return;
+			}
+			data[offset] = ~data[offset];
+			ofstream out(path.c_str(), ios::binary | ios::trunc);
+			out.write(data.data(), data.length());
+		}
+
+		static void readFile(const string& path, string& data) {
+			ifstream in(path.c_str(), ios::binary);
+			stringstream buffer;
+			buffer <<in.rdbuf();
+			data = buffer.str();
+		}
+
+		void check(bool isOk, const string& what) {
+			if (isOk)
+				return;
+			cerr <<"Failed: " <<what <<endl;
+			_failures++;
+		}
+
+		void removeFiles() {
+			string snapshot = BlacklistSnapshot::getPath(_xmlPath);
+			const string files[] = {_xmlPath, snapshot, snapshot + ".tmp"};
+			for (int f = 0; f < 3; f++) {
+				if (File(files[f]).exists())
+					File(files[f]).remove();
+			}
+		}
+
+		string _xmlPath;
+		Blacklist _blacklist;
+		Extensions _extensions;
+		int _failures;
+};
+
+
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		cerr <<"Usage: blacklistsnapshot-test <blacklist file>" <<endl;
+		return 1;
+	}
+	Poco::Util::Application app;
+	int failures;
+	{
+		BlacklistSnapshotTest test(argv[1]);
+		test.testReadBack();
+		test.testChangedXml();
+		test.testCorruptPayload();
+		test.testTruncated();
+		test.testVersion();
+		failures = test.getFailures();
+	}
+	if (failures > 0) {
+		cerr <<failures <<" failures" <<endl;
+		return 1;
+	}
+	cout <<"Snapshots work" <<endl;
+	return 0;
+}
@@ -0,0 +1,269 @@
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <DatabaseTest> checks the partitions of the log: how they're created,
+// switched, merged, rotated and read.
+
+
+#include <iostream>
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Poco/File.h"
+#include "Poco/Path.h"
+#include "Poco/Process.h"
+#include "Poco/Util/Application.h"
+
+#include "Database.h"
+
+using Poco::File;
+using Poco::Util::Application;
+using namespace Poco::Data::Keywords;
+using namespace std;
+
+
+
+class DatabaseTest
+	/// Runs a Database on a file of its own, with dbPartitions, through the
+	/// same calls the DatabaseWriter and the reports make. The Database is
+	/// set up by hand, as Options would read the real config file.
+{
+	public:
+		DatabaseTest(const string& file) {
+			_file = file;
+			_failures = 0;
+			removeFiles();
+			SQLite::Connector::registerConnector();
+			_db = new Database();
+			_db->_logger = &Application::instance().logger();
+			_db->_isPartitioned = true;
+			_db->_databaseFile = file;
+			_db->_session = new Session("SQLite", file);
+			_db->setAutoVacuum();
+			*_db->_session <<"PRAGMA journal_mode = WAL", now;
+			_db->createTables();
+			_db->_readSession = new Session("SQLite", file);
+			*_db->_readSession <<"PRAGMA query_only = ON", now;
+			_db->setStatements();
+		}
+
+		~DatabaseTest() {
+			delete _db;
+			removeFiles();
+		}
+
+		void testCreate() {
+			int reportId = logReport();
+			logUrl("host1.example", "/a", 5);
+			check(countPartitions() == 1, "one partition after the first flush");
+			check(File(getPartition(reportId)).exists(),
+					"the partition is named after the report");
+			check(count("current.urls") == 1, "the URL is in the partition");
+			check(count("main.urls") == 0, "the URL isn't in main");
+		}
+
+		void testCache() {
+			/* a report logged by another process isn't looked for */
+			*_db->_session <<"INSERT INTO reports VALUES (0, 0, 1)", now;
+			logUrl("host1.example", "/b", 6);
+			check(countPartitions() == 1,
+					"no new partition without logReportStart()");
+			check(count("current.urls") == 2, "both URLs are in the partition");
+		}
+
+		void testSwitch() {
+			int first = maxId("current.urls");
+			int reportId = logReport();
+			logUrl("host2.example", "/", 110);
+			check(countPartitions() == 2, "a partition for the new report");
+			check(File(getPartition(reportId)).exists(),
+					"the new partition is named after its report");
+			check(count("current.urls") == 1, "the URL is in the new partition");
+			check(maxId("current.urls") > first,
+					"the rowids go on from the last partition");
+		}
+
+		void testMerge() {
+			vector<string> files = getPartitions();
+			for (int p = 3; p <= DATABASE_MAX_PARTITIONS + 1; p++) {
+				stringstream host;
+				host <<"host" <<p <<".example";
+				logReport();
+				logUrl(host.str(), "/", 100 * (p - 1) + 10);
+			}
+			check(countPartitions() == DATABASE_MAX_PARTITIONS,
+					"never more than DATABASE_MAX_PARTITIONS partitions");
+			check(!File(files[0]).exists(), "the oldest partition is deleted");
+			check(getPartitions()[0] == files[1],
+					"the second partition is the oldest now");
+			check(count("main.urls") == 2, "the oldest partition is in main");
+			check(maxId("main.urls") < minId(files[1]),
+					"the merged URLs keep their rowids");
+		}
+
+		void testRead() {
+			vector<string> hostnames = _db->getDistinctHostnames();
+			check(hostnames.size() == DATABASE_MAX_PARTITIONS + 1,
+					"the URLs of main and every partition are read");
+			History history = _db->getHistory("hostname = 'host1.example'");
+			int rows = 0;
+			for (; history.hasMore(); history.next())
+				rows++;
+			check(rows == 2, "the merged URLs are read");
+		}
+
+		void testRotate() {
+			/* partition p is made to be created at 100 * (p + 1); its URL
+			 * was logged 10 seconds later */
+			vector<string> files = getPartitions();
+			for (size_t p = 0; p < files.size(); p++) {
+				Poco::Int64 created = 100 * (p + 1);
+				*_db->_session <<"UPDATE partitions SET created = :created "
+						<<"WHERE file = :file", use(created), use(files[p]), now;
+			}
+			int reportId = logReport();
+			*_db->_session <<"UPDATE reports SET time = 550 WHERE rowid = :id",
+					use(reportId), now;
+			_db->rotateLog(reportId);
+
+			for (size_t p = 0; p < files.size(); p++) {
+				/* the fifth has URLs from both sides of the report */
+				bool isKept = (p >= 4);
+				check(File(files[p]).exists() == isKept, "partition " + files[p]
+						+ (isKept ? " is kept" : " is dropped"));
+			}
+			check(countPartitions() == (int)files.size() - 4,
+					"the dropped partitions aren't listed");
+			check(count("main.urls") == 0, "the URLs in main are rotated");
+
+			vector<string> hostnames = _db->getDistinctHostnames();
+			check(hostnames.size() == 5, "only the URLs after the report are left");
+			check(find(hostnames.begin(), hostnames.end(), "host6.example")
+					== hostnames.end(),
+					"the URLs of the boundary partition are rotated");
+			check(find(hostnames.begin(), hostnames.end(), "host7.example")
+					!= hostnames.end(),
+					"the partition created after the report is kept");
+		}
+
+		int getFailures() const {
+			return _failures;
+		}
+
+	private:
+		int logReport() {
+			int id = 0;
+			_db->logReportStart(id);
+			return id;
+		}
+
+		void logUrl(const string& host, const string& path, Poco::Int64 time) {
+			HttpRequestView request;
+			request.host = host;
+			request.target = path;
+			_db->logUrl(request, time);
+			_db->flushUrls(true);
+		}
+
+		string getPartition(int reportId) const {
+			stringstream file;
+			file <<_file <<"." <<reportId;
+			return file.str();
+		}
+
+		vector<string> getPartitions() const {
+			vector<string> files;
+			*_db->_session <<"SELECT file FROM partitions ORDER BY rowid",
+					into(files), now;
+			return files;
+		}
+
+		int countPartitions() const {
+			return count("partitions");
+		}
+
+		int count(const string& table) const {
+			int n = -1;
+			*_db->_session <<"SELECT COUNT() FROM " <<table, into(n), now;
+			return n;
+		}
+
+		int maxId(const string& table) const {
+			int id = 0;
+			*_db->_session <<"SELECT IFNULL(MAX(rowid), 0) FROM " <<table,
+					into(id), now;
+			return id;
+		}
+
+		int minId(const string& file) const {
+			int id = 0;
+			*_db->_session <<"ATTACH DATABASE :file AS checked", use(file), now;
+			*_db->_session <<"SELECT IFNULL(MIN(rowid), 0) FROM checked.urls",
+					into(id), now;
+			*_db->_session <<"DETACH DATABASE checked", now;
+			return id;
+		}
+
+		void check(bool isOk, const string& what) {
+			if (isOk)
+				return;
+			cerr <<"Failed: " <<what <<endl;
+			_failures++;
+		}
+
+		void removeFiles() {
+			const char *suffix[] = {"", "-wal", "-shm", "-journal"};
+			for (int id = 0; id <= 20; id++) {
+				string file = (id == 0 ? _file : getPartition(id));
+				for (int s = 0; s < 4; s++) {
+					File f(file + suffix[s]);
+					if (f.exists())
+						f.remove();
+				}
+			}
+		}
+
+		string _file;
+		Database *_db;
+		int _failures;
+};
+
+
+
+int main() {
+	Poco::Util::Application app;
+	stringstream file;
+	file <<Poco::Path::temp() <<"database-test-" <<Poco::Process::id()
+			<<".sqlite";
+	int failures;
+	{
+		DatabaseTest test(file.str());
+		test.testCreate();
+		test.testCache();
+		test.testSwitch();
+		test.testMerge();
+		test.testRead();
+		test.testRotate();
+		failures = test.getFailures();
+	}
+	if (failures > 0) {
+		cerr <<failures <<" failures" <<endl;
+		return 1;
+	}
+	cout <<"Partitions work" <<endl;
+	return 0;
+}
@@ -0,0 +1,546 @@
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <FilterTest> checks Filter against the plain regular expressions it used
+// before, with the blacklist in tests/blacklist.xml.
+//
+// Usage: filter-test <blacklist file>
+
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "Poco/Exception.h"
+#include "Poco/RegularExpression.h"
+#include "Poco/URI.h"
+#include "Poco/Util/Application.h"
+
+#include "Filter.h"
+
+using Poco::RegularExpression;
+using namespace std;
+
+
+
+class FilterTest
+	/// Runs a Filter on the test blacklist, once with every regular
+	/// expression run by PCRE, and once with the combined DFA, and compares
+	/// what it finds to what the regular expressions alone would find.
+{
+	public:
+		FilterTest(const string& blacklistFile):
+			_wordDelimiter("[\\s-_+\"']||\\.", 0, true),
+			_splitExtension("/?(?:[^/?#]+/)+(?:[^?#]+\\.)([a-zA-Z0-9]{1,4})"
+					"(?:$|\\?|#).*", 0, true),
+			_splitToken("((\\?|\\&|;).*?\\=)|\\/|(\\%2F)|#", 0, true),
+			_pcre(blacklistFile),
+			_combined(blacklistFile)
+		{
+			_failures = 0;
+			_combined._isCombined = true;
+			_combined.buildMultiMatcher();
+			check(_pcre._blacklist.size() == 3, "the blacklist is loaded");
+			check(_combined._multiMatcher.getPatternCount() > 0,
+					"the combined DFA has patterns");
+		}
+
+		void testToken(const string& token) {
+			for (size_t i = 0; i < token.length(); i++)
+				testChar(token[i], token);
+		}
+
+		void testAscii() {
+			for (int c = 1; c < 128; c++)
+				testChar((char)c, "ASCII");
+		}
+
+		void testUrl(const string& host, const string& target) {
+			testUrl(_pcre, "PCRE", host, target);
+			testUrl(_combined, "DFA", host, target);
+		}
+
+		void testTokens(const string& text)
+			/// Compare nextToken() to splitting text with _splitToken, the
+			/// expression Filter used before.
+		{
+			RegularExpression::Match m;
+			string_view token;
+			size_t o = 0,
+				offset = 0;
+			bool isToken;
+			while (o < text.length()) {
+				_splitToken.match(text, o, m);
+				if (m.offset == string::npos)
+					m.offset = text.length();
+				isToken = Filter::nextToken(text, offset, token);
+				check(isToken && token == text.substr(o, m.offset - o),
+						"nextToken() on \"" + text + "\" found \"" + string(token)
+						+ "\" instead of \"" + text.substr(o, m.offset - o) + "\"");
+				o = m.offset + m.length;
+				check(offset == o, "nextToken() on \"" + text
+						+ "\" stopped at the wrong delimiter");
+				if (!isToken || offset != o)
+					return;
+			}
+			check(!Filter::nextToken(text, offset, token),
+					"nextToken() on \"" + text + "\" goes past the end");
+		}
+
+		void testBold(const string& url, const string& patterns)
+			/// Compare highlight() and abbreviate() to the substitutions they
+			/// replaced, highlighting the space-separated patterns in turn.
+		{
+			string bold = url,
+				expected = url,
+				pattern,
+				abbr;
+			istringstream in(patterns);
+			while (in >>pattern) {
+				RegularExpression re(pattern, RegularExpression::RE_CASELESS, true);
+				Filter::highlight(re, bold);
+				re.subst(expected, "<b>$0</b>", RegularExpression::RE_GLOBAL);
+			}
+			check(bold == expected, "highlight() made \"" + bold
+					+ "\" instead of \"" + expected + "\"");
+			Filter::abbreviate(expected, abbr);
+			check(abbr == abbreviate(expected), "abbreviate() made \"" + abbr
+					+ "\" instead of \"" + abbreviate(expected) + "\"");
+		}
+
+		void testExtension(const string& url)
+			/// Compare findExtension() and getExtensionFactor() to the
+			/// _splitExtension expression Filter used before, and to trying
+			/// every extension of the blacklist in turn.
+		{
+			string ext;
+			bool expected = _splitExtension.match(url),
+				actual;
+			float factor = 1;
+			size_t start,
+				length;
+			if (expected) {
+				ext = url;
+				_splitExtension.subst(ext, "$1");
+				for (Extensions::iterator e = _pcre._extensions.begin();
+						e != _pcre._extensions.end(); e++)
+				{
+					if (e->re->match(ext)) {
+						factor = (float)e->strength/100;
+						break;
+					}
+				}
+			}
+			actual = Filter::findExtension(url, start, length);
+			check(actual == expected, "findExtension() on \"" + url + "\" is "
+					+ (actual ? "true" : "false"));
+			if (actual && expected)
+				check(url.substr(start, length) == ext, "findExtension() found \""
+						+ url.substr(start, length) + "\" in \"" + url
+						+ "\" instead of \"" + ext + "\"");
+			check(_pcre.getExtensionFactor(url) == factor,
+					"getExtensionFactor() on \"" + url + "\" differs");
+		}
+
+		void testPackExtension() {
+			check(Filter::packExtension("JpG", 3) == Filter::packExtension("jpg", 3),
+					"packExtension() ignores case");
+			check(Filter::packExtension("jpg", 3) != Filter::packExtension("jpe", 3),
+					"packExtension() tells extensions apart");
+			check(Filter::packExtension("jpg", 3) != Filter::packExtension("jpg", 2),
+					"packExtension() tells prefixes apart");
+			check(Filter::packExtension("JPEG5", 5) == Filter::packExtension("jpeg", 4),
+					"packExtension() keeps EXTENSION_MAX_LEN characters");
+			check(_pcre._extensionPatterns.size() == 2,
+					"the extensions that aren't literal are tried in turn");
+		}
+
+		void testPrefilter() {
+			check(_pcre.getKeywordsSkipped() > 0,
+					"the literals let keywords be skipped");
+			check(_pcre.getKeywordsConfirmed() > 0,
+					"the keywords whose literals are found are run");
+		}
+
+		int getFailures() const {
+			return _failures;
+		}
+
+		static string fill(size_t length)
+			/// Returns length characters of plain text none of the test
+			/// patterns match.
+		{
+			string text;
+			while (text.length() < length)
+				text += "abcdefghij";
+			return text.substr(0, length);
+		}
+
+	private:
+		static string abbreviate(string boldUrl)
+			/// The abbreviated URL, as Filter made it before abbreviate().
+		{
+			RegularExpression a ("(^[^\\/]*\\/)([^<>]*)([^<>]{25}<b>)", 0, false),
+				b ("(<\\/b>[^<>]{25})([^<>]*)([^<>]{25}<b>)", 0, false),
+				c ("(<\\/b>[^<>]{25})([^<>]*$)", 0, false);
+			a.subst(boldUrl, "$1 ... $3", RegularExpression::RE_GLOBAL);
+			b.subst(boldUrl, "$1 ... $3", RegularExpression::RE_GLOBAL);
+			c.subst(boldUrl, "$1 ...", RegularExpression::RE_GLOBAL);
+			return boldUrl;
+		}
+
+		void testChar(char c, const string& where) {
+			bool expected = _wordDelimiter.match(string(1, c)),
+				actual = Filter::isWordDelimiter(c);
+			if (expected == actual)
+				return;
+			cerr <<"'" <<c <<"' (" <<(int)(unsigned char)c <<") in " <<where
+					<<": isWordDelimiter() is " <<actual
+					<<", the regular expression " <<expected <<endl;
+			_failures++;
+		}
+
+		void testUrl(Filter& filter, const string& engine, const string& host,
+				const string& target)
+			/// Compare isUrlMatch() to running every regular expression of
+			/// every keyword on the URL, as it did before the literals and
+			/// the combined DFA.
+		{
+			HttpRequestView request;
+			request.host = host;
+			request.target = target;
+			string url;
+			request.getUrl(url);
+			BlacklistMatch match;
+			bool isMatch = filter.isUrlMatch(request, match),
+				isExpected = false,
+				isWhitelist = false;
+			RegularExpression::Match m;
+			vector<const BlacklistKeyword*> hits;
+			vector<Poco::UInt32> categories;
+			int strength = 0;
+			string bold = url;
+
+			for (Blacklist::iterator c = filter._blacklist.begin();
+					c != filter._blacklist.end(); c++)
+			{
+				for (vector<BlacklistKeyword>::iterator k = c->keyword.begin();
+						k != c->keyword.end(); k++)
+				{
+					bool isSubMatch = true;
+					for (vector< SharedPtr<RegularExpression> >::iterator
+							r = k->re.begin(); r != k->re.end(); r++)
+					{
+						if (!(**r).match(url, m)) {
+							isSubMatch = false;
+							break;
+						}
+					}
+					if (!isSubMatch)
+						continue;
+					for (vector< SharedPtr<RegularExpression> >::iterator
+							r = k->re.begin(); r != k->re.end(); r++)
+					{
+						(**r).subst(bold, "<b>$0</b>", RegularExpression::RE_GLOBAL);
+					}
+					hits.push_back(&*k);
+					categories.push_back(KeywordTable::intern(c->name));
+					strength += k->strength;
+					if (c->name == "Whitelist")
+						isWhitelist = true;
+					else
+						isExpected = true;
+				}
+			}
+
+			string where = engine + " on \"" + url + "\": ";
+			check(isMatch == isExpected, where + "isUrlMatch() is "
+					+ (isMatch ? "true" : "false"));
+			check(match.whitelist == isWhitelist, where + "whitelist is "
+					+ (match.whitelist ? "true" : "false"));
+			check(match.strength == (isExpected ? strength : 0),
+					where + "the strength differs");
+			check(match.boldUrl == (isExpected ? bold : ""),
+					where + "the bold URL is \"" + match.boldUrl + "\"");
+			check(match.abbrUrl == (isExpected ? abbreviate(bold) : ""),
+					where + "the abbreviated URL is \"" + match.abbrUrl + "\"");
+			if (match.keyword.size() != hits.size()) {
+				check(false, where + "the number of keywords differs");
+				return;
+			}
+			for (size_t i = 0; i < hits.size(); i++) {
+				check(match.keyword[i].keyword == hits[i]->id
+						&& match.keyword[i].category == categories[i]
+						&& match.keyword[i].strength == hits[i]->strength,
+						where + "found " + KeywordTable::lookup(
+						match.keyword[i].keyword) + " instead of "
+						+ hits[i]->asString);
+			}
+			if (isMatch && isExpected)
+				testTokenMatch(filter, where, request, match, hits);
+		}
+
+		void testTokenMatch(Filter& filter, const string& where,
+				const HttpRequestView& request, BlacklistMatch& match,
+				const vector<const BlacklistKeyword*>& hits)
+			/// Compare isTokenMatch() to scoring the keywords found in each
+			/// token _splitToken split the decoded URL into, as it did before
+			/// nextToken().
+		{
+			RegularExpression::Match m,
+				n;
+			bool isMatch,
+				isExpected = false,
+				isSubMatch;
+			float strength = 0,
+				strengthFactor,
+				wordFactor;
+			int tokenMatches;
+			size_t o = 0;
+			string url,
+				decodedUrl,
+				token;
+			request.getUrl(url);
+			try {
+				Poco::URI::decode(url, decodedUrl);
+			}
+			catch (Poco::Exception &exc) {
+				decodedUrl = url;
+			}
+			while (o < decodedUrl.length()) {
+				_splitToken.match(decodedUrl, o, m);
+				if (m.offset == string::npos)
+					m.offset = decodedUrl.length();
+				token = decodedUrl.substr(o, m.offset - o);
+				o = m.offset + m.length;
+				if (token.length() <= 2)
+					continue;
+				tokenMatches = 0;
+				for (size_t i = 0; i < hits.size(); i++) {
+					isSubMatch = true;
+					strengthFactor = 0;
+					for (vector< SharedPtr<RegularExpression> >::const_iterator
+							r = hits[i]->re.begin(); r != hits[i]->re.end(); r++)
+					{
+						if (!(**r).match(token, n)) {
+							isSubMatch = false;
+							break;
+						}
+						while (n.offset != string::npos) {
+							wordFactor = 0.5;
+							if (n.offset == 0
+									|| _wordDelimiter.match(token.substr(n.offset - 1, 1)))
+								wordFactor += 0.5;
+							if (n.offset + n.length == token.length()
+									|| _wordDelimiter.match(
+									token.substr(n.offset + n.length, 1)))
+								wordFactor += 0.5;
+							strengthFactor += (float)n.length/token.length()
+									* wordFactor;
+							tokenMatches++;
+							(**r).match(token, n.offset + n.length, n);
+						}
+					}
+					if (isSubMatch) {
+						isExpected = true;
+						strengthFactor += strengthFactor/tokenMatches;
+						strength += strengthFactor * hits[i]->strength;
+					}
+				}
+			}
+			strength *= filter.getExtensionFactor(url);
+
+			isMatch = filter.isTokenMatch(request, match);
+			check(isMatch == isExpected, where + "isTokenMatch() is "
+					+ (isMatch ? "true" : "false"));
+			if (isMatch && isExpected)
+				check(match.strength == (int)strength,
+						where + "the strength of the tokens differs");
+		}
+
+		void check(bool isOk, const string& what) {
+			if (isOk)
+				return;
+			cerr <<"Failed: " <<what <<endl;
+			_failures++;
+		}
+
+		RegularExpression _wordDelimiter;
+		RegularExpression _splitExtension;
+		RegularExpression _splitToken;
+		Filter _pcre;
+		Filter _combined;
+		int _failures;
+};
+
+
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		cerr <<"Usage: filter-test <blacklist file>" <<endl;
+		return 1;
+	}
+	Poco::Util::Application app;
+	FilterTest test(argv[1]);
+	test.testToken("www.free-sex_pics.com");
+	test.testToken("'adult'+video.mp4 page.2");
+	test.testAscii();
+
+	/* "?", "&" and ";" with and without a "=" after them, before and after
+	 * a line break, "%2F" in both cases, and delimiters next to each other */
+	const char *texts[] = {
+		"", "/", "//", "a", "abc/def", "a/b#c?d=e&f;g", "a?b=c", "a?b", "a?b=",
+		"a?=b", "?", "?=", "a?b?c=d", "a&b;c=d", "&&&=", "a=b?c", "x?y/z=w",
+		"a?b\n=c", "a\n?b=c", "a;\n;b=c", "a?\n", "a?b\r=c", "a%2Fb%2fc",
+		"%2F%2F", "a/%2F/b", "a?%2F=b", "%2", "a%2", "a%", "#x#",
+		"sex?a=1&b=2;c=3#top/x", "www.example.com/search?q=sex&page=2"
+	};
+	for (size_t t = 0; t < sizeof(texts) / sizeof(texts[0]); t++)
+		test.testTokens(texts[t]);
+
+	/* keywords of one and of several expressions, anchors, expressions
+	 * only PCRE runs, bytes beyond ASCII and the whitelist */
+	const char *urls[][2] = {
+		{"www.example.com", "/"},
+		{"www.example.com", "/index.html"},
+		{"www.pornhub.example", "/"},
+		{"WWW.PORNHUB.EXAMPLE", "/VIDEOS"},
+		{"www.example.com", "/search?q=sexy+pictures"},
+		{"www.example.com", "/sexual-health.html"},
+		{"www.essex.gov.uk", "/"},
+		{"www.middlesex.example", "/sussex/essex"},
+		{"www.example.org", "/"},
+		{"www.example.com", "/adult/"},
+		{"www.example.com", "/adult/video/123.mp4"},
+		{"www.example.com", "/video?cat=ADULT"},
+		{"www.example.com", "/hot-girl/naked.jpg"},
+		{"www.example.com", "/hotgirls-naked"},
+		{"www.example.com", "/nude/"},
+		{"www.example.com", "/nudes"},
+		{"www.example.com", "/page/120x"},
+		{"www.example.com", "/1x"},
+		{"www.example.com", "/p0rno/"},
+		{"www.example.com", "/porno"},
+		{"www.freedom.example", "/"},
+		{"cdn.www.free.example", "/"},
+		{"www.example.xxx", ""},
+		{"www.example.xxx", "/"},
+		{"www.example.com", "/ESCORT-service"},
+		{"www.example.com", "/caf\xc3\xa9/erotique"},
+		{"www.example.com", "/CAF\xc3\xa9-EROTIQUE"},
+		{"www.example.com", "/CAF\xc3\x89-EROTIQUE"},
+		{"casino.example", "/poker/online"},
+		{"www.example.com", "/poker"},
+		{"www.example.com", "/alphabet/betting"},
+		{"www.example.com", "/bets"},
+		{"www.example.com", "/%73ex"},
+		{"www.example.com", "/search?q=sexy&page=2;lang=en#top"},
+		{"www.example.com", "/a?sexy"},
+		{"www.example.com", "/porn%2Fxxx%2fsexy"},
+		{"www.example.com", "/sexy%0A?x=porn"},
+		{"www.example.com", "/xx/sex/porn-xxx.jpg"},
+		{"www.example.com", "/gallery/2019/summer/holiday/pictures/sexy/beach"
+				"/volleyball/team/photos/xxx/page/1?ref=newsletter&campaign=spring"},
+		{"", ""}
+	};
+	for (size_t u = 0; u < sizeof(urls) / sizeof(urls[0]); u++)
+		test.testUrl(urls[u][0], urls[u][1]);
+	test.testPrefilter();
+
+	/* matches overlapping each other and the tags, at the start and end,
+	 * and plain text just around the 25 characters kept of it */
+	test.testBold("www.example.com/banana", "ana");
+	test.testBold("www.example.com/sexy", "sexy exy");
+	test.testBold("www.example.com/sexy", "sex sexy");
+	test.testBold("www.example.com/bet/about", "bet b");
+	test.testBold("www.example.com/bet/about", "bet b> <b> /b");
+	test.testBold("www.example.com/porno", "p[o0]rn[o0] porn");
+	test.testBold("porn.example.com/xxx", "porn xxx");
+	test.testBold("SEX.example.com/Sexy/SEX", "sex");
+	for (size_t n = 24; n <= 26; n++) {
+		test.testBold("www.example.com/" + FilterTest::fill(n) + "sex", "sex");
+		test.testBold("www.example.com/" + FilterTest::fill(n) + "sex/"
+				+ FilterTest::fill(n), "sex");
+		test.testBold("www.example.com/sex" + FilterTest::fill(n), "sex");
+	}
+	for (size_t n = 49; n <= 52; n++)
+		test.testBold("www.example.com/sex" + FilterTest::fill(n) + "sex", "sex");
+	test.testBold("sex.example.com" + FilterTest::fill(60) + "sex"
+			+ FilterTest::fill(60), "sex");
+	test.testBold(FilterTest::fill(40) + "sex" + FilterTest::fill(40), "sex");
+	test.testBold("www.sex.com/" + FilterTest::fill(30) + "sex"
+			+ FilterTest::fill(10) + "sex" + FilterTest::fill(80) + "sex/"
+			+ FilterTest::fill(5) + "sex" + FilterTest::fill(26), "sex");
+	test.testBold("www.example.com/" + FilterTest::fill(30) + "sexy"
+			+ FilterTest::fill(60) + "sex" + FilterTest::fill(26), "sex sexy");
+	test.testBold("www.example.com/" + FilterTest::fill(40), "sex");
+
+	/* query strings, fragments, several dots, upper case, no extension, and
+	 * the first extension listed winning */
+	const char *extensionUrls[] = {
+		"www.example.com/",
+		"www.example.com/index.html",
+		"www.example.com/INDEX.HTML",
+		"www.example.com/pic.jpg",
+		"www.example.com/pic.JPEG",
+		"www.example.com/pic.png?size=big",
+		"www.example.com/pic.png#top",
+		"www.example.com/pic.PNG?a=1#b",
+		"www.example.com/pic.jpg?",
+		"www.example.com/pic.jpg#",
+		"www.example.com/archive.tar.gz",
+		"www.example.com/a.b.c.gif",
+		"www.example.com/v1.2/file",
+		"www.example.com/dir.v2/file.mp4",
+		"www.example.com/script.php?file=a.jpg",
+		"www.example.com/dir/file.htm?x=1&y=2.png#frag.gif",
+		"www.example.com/dir/?q=a.jpg",
+		"www.example.com/dir/#a.jpg",
+		"www.example.com/?x=y.jpg/z.png",
+		"www.example.com/a/b.c/d",
+		"www.example.com/.jpg",
+		"www.example.com/a.jpg",
+		"www.example.com//a.jpg",
+		"/a/b.jpg",
+		"a.jpg",
+		"www.example.com",
+		"www.example.com/file.jpeg5",
+		"www.example.com/file.j-g",
+		"www.example.com/file.",
+		"www.example.com/p%2Ejpg",
+		"www.example.com/file.mpeg",
+		"www.example.com/FILE.AVI",
+		"www.example.com/clip.Mp4",
+		"www.example.com/notes.txt",
+		"www.example.com/song.mp3",
+		"www.example.com/file.mp4\n",
+		"www.example.com/file.mp4?a\nb",
+		"www.example.com/file.mp4\n?a",
+		"www.example.com/a\nb/c.jpg",
+		"",
+		"/",
+		"//"
+	};
+	for (size_t u = 0; u < sizeof(extensionUrls) / sizeof(extensionUrls[0]); u++)
+		test.testExtension(extensionUrls[u]);
+	test.testPackExtension();
+
+	if (test.getFailures() > 0) {
+		cerr <<test.getFailures() <<" failures" <<endl;
+		return 1;
+	}
+	cout <<"Filter agrees with the regular expressions" <<endl;
+	return 0;
+}
@@ -0,0 +1,195 @@
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <MultiMatcherTest> checks MultiMatcher against the regular expressions it
+// stands in for.
+
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Poco/RegularExpression.h"
+#include "Poco/SharedPtr.h"
+
+#include "MultiMatcher.h"
+
+using Poco::RegularExpression;
+using Poco::SharedPtr;
+using namespace std;
+
+
+
+class MultiMatcherTest
+	/// Adds every pattern to one MultiMatcher, the way Filter does, and
+	/// compares what a scan tells to RegularExpression::match() with
+	/// RE_CASELESS, which is how Filter ran the patterns before.
+{
+	public:
+		MultiMatcherTest() {
+			_failures = 0;
+		}
+
+		void add(const string& pattern) {
+			int id = _matcher.add(pattern);
+			if (id < 0) {
+				cerr <<"Refused \"" <<pattern <<"\"" <<endl;
+				_failures++;
+				return;
+			}
+			_patterns.push_back(pattern);
+			_re.push_back(new RegularExpression(pattern,
+					RegularExpression::RE_CASELESS, true));
+		}
+
+		void refuse(const string& pattern) {
+			MultiMatcher matcher;
+			if (matcher.add(pattern) < 0)
+				return;
+			cerr <<"Accepted \"" <<pattern <<"\", which needs PCRE" <<endl;
+			_failures++;
+		}
+
+		void compile() {
+			_matcher.compile();
+		}
+
+		void test(const string& text) {
+			RegularExpression::Match m;
+			vector<char> matched;
+			_matcher.scan(text.data(), text.length(), _cache, matched);
+			for (size_t i = 0; i < _patterns.size(); i++) {
+				bool expected = (_re[i]->match(text, m) > 0),
+					actual = (matched[i] != 0);
+				if (expected == actual)
+					continue;
+				cerr <<"\"" <<_patterns[i] <<"\" on \"" <<text
+						<<"\": MultiMatcher says " <<actual
+						<<", the regular expression " <<expected <<endl;
+				_failures++;
+			}
+		}
+
+		int getFailures() const {
+			return _failures;
+		}
+
+	private:
+		MultiMatcher _matcher;
+		MultiMatcher::Cache _cache;
+		vector<string> _patterns;
+		vector< SharedPtr<RegularExpression> > _re;
+		int _failures;
+};
+
+
+
+int main() {
+	MultiMatcherTest test;
+
+	/* anchors */
+	test.add("^www\\.");
+	test.add("\\.com$");
+	test.add("^sex$");
+	test.add("^(?:ab|cd)e");
+	test.add("x\\$");
+	test.add("x\\\\$");
+
+	/* classes */
+	test.add("[a-c]x");
+	test.add("[^a-z0-9/]sex");
+	test.add("[\\w.-]+@");
+	test.add("x[]a]");
+	test.add("[-a]b");
+	test.add("[\\d\\s]q");
+	test.add("\\S+\\.exe");
+	test.add("\\W\\D");
+
+	/* counted repetition, and braces taken literally */
+	test.add("\\d{2,3}x");
+	test.add("a{2}");
+	test.add("ab{2,4}c");
+	test.add("(?:ab){2,}c");
+	test.add("x.{0,3}y");
+	test.add("a{b");
+	test.add("a{1,x}");
+	test.add("k.*?z");
+
+	/* caseless */
+	test.add("SeX");
+	test.add("[A-C]Y");
+	test.add("porn|xxx");
+	test.add("(?:x|y)+z");
+
+	/* bytes beyond ASCII, which PCRE doesn't fold without UTF-8 */
+	test.add("\\xe9t\\xe9");
+	test.add("caf\xc3\xa9");
+	test.add("[\\x80-\\xff]{2}");
+	test.add("\xc3\x89t\xc3\x89");
+	test.add("[^\\x00-\\x7f]n");
+
+	test.refuse("\\bsex\\b");
+	test.refuse("(a)\\1");
+	test.refuse("(?=a)b");
+	test.refuse("(?!a)b");
+	test.refuse("a++");
+	test.refuse("[[:alpha:]]");
+	test.refuse("^a|b");
+	test.refuse("a{2,1}");
+	test.compile();
+
+	const char *texts[] = {
+		"",
+		"www.example.com",
+		"WWW.EXAMPLE.COM",
+		"www.example.com\n",
+		"www.example.com\n\n",
+		"http://www.example.com/",
+		"sex",
+		"SEX",
+		"sex\n",
+		"sexy",
+		"abe", "cde", "ABE", "xabe",
+		"price x$", "x\\",
+		"ax", "DX", "bbx",
+		"a.sex", "/sex", "0sex", "A-SEX",
+		"mail.me@example.com", "@home",
+		"x]", "xa", "x[", "-b", "ab", "Ab",
+		"1q", " q", "\tq", "aq",
+		"setup.exe", "a b.EXE", ".exe",
+		"!a", "a1", "!1",
+		"12x", "1x", "1234x", "aa", "A", "AA",
+		"abbc", "abc", "abbbbbc", "ABBBBC",
+		"ababc", "abc", "ABABABC",
+		"xy", "xaaay", "xaaaay", "x\ny",
+		"a{b", "A{B", "a{1,x}", "a{1,2}",
+		"kz", "k123z", "K\nz",
+		"pornography", "XXX.com", "xyz", "yyYZ", "z",
+		"\xe9t\xe9", "\xc9t\xc9", "caf\xc3\xa9", "CAF\xc3\xa9",
+		"caf\xc3\x89", "\xc3\xa9t\xc3\xa9", "\xc3\x89T\xc3\x89",
+		"\xe9n", "\xe9N", "an",
+		"http://adult.example.com/gallery/12345/picture-sex.jpg?size=big#top",
+		"/search?q=SEX+videos&page=2"
+	};
+	for (size_t t = 0; t < sizeof(texts) / sizeof(texts[0]); t++)
+		test.test(texts[t]);
+
+	if (test.getFailures() > 0) {
+		cerr <<test.getFailures() <<" failures" <<endl;
+		return 1;
+	}
+	cout <<"MultiMatcher agrees with PCRE" <<endl;
+	return 0;
+}
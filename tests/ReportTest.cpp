@@ -0,0 +1,163 @@
+// This file is part of Net Responsibility.
+//
+// Net Responsibility is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Net Responsibility is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Net Responsibility.  If not, see <http://www.gnu.org/licenses/>.
+//
+// <ReportTest> checks how the history section groups the hostnames by
+// domain, against the SQLite queries it replaced.
+
+
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "Poco/Data/Session.h"
+#include "Poco/Data/SQLite/Connector.h"
+
+#include "Report.h"
+
+using Poco::Data::Session;
+using namespace Poco::Data::Keywords;
+using namespace std;
+
+
+
+class ReportTest
+	/// Compares Report::groupByDomain() and Report::isLike() to SQLite's
+	/// LIKE, in an in-memory database holding the hostnames. The history
+	/// section used to query the hostnames of each domain with
+	/// "hostname LIKE '%domain'", ordered by hostname.
+{
+	public:
+		ReportTest() {
+			_failures = 0;
+			Poco::Data::SQLite::Connector::registerConnector();
+			_session = new Session("SQLite", ":memory:");
+			*_session <<"CREATE TABLE urls (hostname VARCHAR)", now;
+		}
+
+		~ReportTest() {
+			delete _session;
+			Poco::Data::SQLite::Connector::unregisterConnector();
+		}
+
+		void addHostname(const string& hostname) {
+			*_session <<"INSERT INTO urls VALUES (:hostname)", use(hostname), now;
+		}
+
+		void testGroups(const set<string>& domains) {
+			vector<string> hostnames;
+			map<string, vector<string> > hosts;
+			*_session <<"SELECT DISTINCT hostname FROM urls ORDER BY hostname",
+					into(hostnames), now;
+			Report::groupByDomain(hostnames, domains, hosts);
+
+			for (set<string>::const_iterator d = domains.begin();
+					d != domains.end(); d++)
+			{
+				vector<string> expected;
+				string domain = *d;
+				*_session <<"SELECT DISTINCT hostname FROM urls "
+						<<"WHERE hostname LIKE '%' || :domain ORDER BY hostname",
+						use(domain), into(expected), now;
+				if (hosts[*d] == expected)
+					continue;
+				cerr <<"Failed: the hostnames of \"" <<*d <<"\" are";
+				print(hosts[*d]);
+				cerr <<" instead of";
+				print(expected);
+				cerr <<endl;
+				_failures++;
+			}
+		}
+
+		void testLike(const string& text, const string& pattern) {
+			bool expected = false,
+				actual = Report::isLike(text.c_str(), pattern.c_str());
+			string t = text,
+				p = pattern;
+			*_session <<"SELECT :text LIKE :pattern", use(t), use(p),
+					into(expected), now;
+			if (expected == actual)
+				return;
+			cerr <<"Failed: isLike(\"" <<text <<"\", \"" <<pattern <<"\") is "
+					<<actual <<", LIKE " <<expected <<endl;
+			_failures++;
+		}
+
+		int getFailures() const {
+			return _failures;
+		}
+
+	private:
+		static void print(const vector<string>& hostnames) {
+			for (vector<string>::const_iterator h = hostnames.begin();
+					h != hostnames.end(); h++)
+			{
+				cerr <<" " <<*h;
+			}
+		}
+
+		Session *_session;
+		int _failures;
+};
+
+
+
+int main() {
+	ReportTest test;
+
+	/* mixed case, '%' and '_' in the hostnames themselves, bytes beyond
+	 * ASCII, which LIKE only compares as they are, and a backslash, which
+	 * isn't an escape without ESCAPE */
+	const char *hostnames[] = {
+		"www.example.com", "WWW.Example.COM", "example.com", "myexample.com",
+		"exam_le.com", "exampl.com", "examplee.com", "cdn.example.co.uk",
+		"example.co.uk", "b\xc3\xbc" "cher.de", "B\xc3\x9c" "CHER.DE",
+		"b\xc3\xbc" "ch.de", "xn--bcher-kva.de", "localhost", "192.168.0.1",
+		"a%b.net", "a_b.net", "axb.net", "ex\\ample.org", "x.y", "_.com",
+		"%.com"
+	};
+	for (size_t h = 0; h < sizeof(hostnames) / sizeof(hostnames[0]); h++)
+		test.addHostname(hostnames[h]);
+
+	const char *domains[] = {
+		"example.com", "EXAMPLE.COM", "Example.Com", "exam_le.com",
+		"ex%le.com", "_.com", "%.com", "%", "_", "", "co.uk", "de", "m",
+		"b_cher.de", "b__cher.de", "b\xc3\xbc" "cher.de", "B\xc3\x9c" "CHER.DE",
+		"localhost", "0.1", "a%b.net", "a_b.net", "ex\\ample.org"
+	};
+	test.testGroups(set<string>(domains,
+			domains + sizeof(domains) / sizeof(domains[0])));
+
+	const char *likes[][2] = {
+		{"abc", "abc"}, {"ABC", "abc"}, {"abc", "a%"}, {"abc", "%c"},
+		{"abc", "%b%"}, {"abc", "_b_"}, {"abc", "__"}, {"abc", "___"},
+		{"abc", "____"}, {"", "%"}, {"", ""}, {"", "_"}, {"a", "%%"},
+		{"abc", "a%%c"}, {"\xc3\xbc", "_"}, {"\xc3\xbc", "__"},
+		{"x\xc3\xbcy", "x_y"}, {"\xc3\x9c", "\xc3\xbc"}, {"a%b", "a%b"},
+		{"axb", "a\\%b"}, {"a\\b", "a\\b"}, {"mississippi", "%iss%ipp%"},
+		{"mississippi", "m%ss_ss%i"}, {"aaa", "%a%a%a%a"}, {"[x]", "[x]"}
+	};
+	for (size_t l = 0; l < sizeof(likes) / sizeof(likes[0]); l++)
+		test.testLike(likes[l][0], likes[l][1]);
+
+	if (test.getFailures() > 0) {
+		cerr <<test.getFailures() <<" failures" <<endl;
+		return 1;
+	}
+	cout <<"Domains are grouped as by LIKE" <<endl;
+	return 0;
+}